@@ -0,0 +1,375 @@
+#include "Benchmark.hpp"
+#include "Trajectories.hpp"
+#include <ghmm/GHMM.hpp>
+#include <ghmm/SpecializedGHMM.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+
+namespace bench
+{
+
+
+namespace
+{
+  // Nodes a lane grows, see LaneGenerator
+  const double LANE_LENGTH = 25;
+
+  template < int N, int FULL_N >
+  void model( Runner & runner, const Config & config, uint32_t nodes, double spacing )
+  {
+    typedef ghmm::GHMM< double, N, FULL_N > ghmm_type;
+    typedef LaneGenerator< double, N, FULL_N > generator_type;
+    typedef typename generator_type::trajectory_type trajectory_type;
+
+    uint32_t lanes = std::max( 1.0, nodes / LANE_LENGTH );
+    generator_type generator( lanes, LANE_LENGTH, spacing );
+    std::vector< trajectory_type > trajectories( lanes );
+    for ( uint32_t lane = 0; lane < lanes; ++lane ) {
+      generator.trajectory( lane, 4 * LANE_LENGTH, trajectories[lane] );
+    }
+
+    ghmm_type ghmm(
+      ghmm_type::full_matrix_type::Identity(),
+      ghmm_type::observation_matrix_type::Identity(),
+      ghmm_type::goal_matrix_type::Identity(),
+      1, 0.01,
+      0.001, 0.001
+    );
+    ghmm.learnBatch( trajectories.begin(), trajectories.end() );
+
+    value_map parameters;
+    parameters["N"] = N;
+    parameters["FULL_N"] = FULL_N;
+    parameters["nodes"] = nodes;
+    parameters["spacing"] = spacing;
+
+    // Observations along the middle lane
+    typedef typename ghmm_type::observation_type observation_type;
+    std::vector< 
+      observation_type, 
+      Eigen::aligned_allocator<observation_type> 
+    > observations( 4 * LANE_LENGTH );
+    for ( uint32_t i = 0; i < observations.size(); ++i ) {
+      observations[i] = generator.position( lanes / 2, i * LANE_LENGTH / observations.size() );
+    }
+    typename ghmm_type::goal_type goal = generator.goal( lanes / 2 );
+    typename ghmm_type::track_type track;
+
+    if ( runner.selected( "GHMM::update" ) ) {
+      ghmm.initTrack( track );
+      State state = runner.state();
+      uint32_t i = 0;
+      while ( state.running() ) {
+        ghmm.update( track, observations[i++ % observations.size()] );
+      }
+      state.counter( "nodes", boost::num_vertices( ghmm.graph() ) );
+      state.counter( "edges", boost::num_edges( ghmm.graph() ) );
+      runner.record( "GHMM::update", parameters, state );
+    }
+
+    for ( uint32_t h = 0; h < config.horizons.size(); ++h ) {
+      uint32_t horizon = config.horizons[h];
+      value_map horizonParameters = parameters;
+      horizonParameters["horizon"] = horizon;
+
+      ghmm.initTrack( track );
+      for ( uint32_t i = 0; i < observations.size() / 2; ++i ) {
+        ghmm.update( track, observations[i] );
+      }
+
+      if ( runner.selected( "GHMM::predict" ) ) {
+        State state = runner.state();
+        while ( state.running() ) {
+          ghmm.predict( track, horizon );
+        }
+        runner.record( "GHMM::predict", horizonParameters, state );
+      }
+
+      ghmm.predict( track, horizon );
+
+      if ( runner.selected( "GHMM::observationPdf" ) ) {
+        State state = runner.state();
+        uint32_t i = 0;
+        while ( state.running() ) {
+          keep( ghmm.observationPdf( track, horizon, observations[i++ % observations.size()] ) );
+        }
+        runner.record( "GHMM::observationPdf", horizonParameters, state );
+      }
+
+      if ( runner.selected( "GHMM::goalPdf" ) ) {
+        State state = runner.state();
+        while ( state.running() ) {
+          keep( ghmm.goalPdf( track, goal ) );
+        }
+        runner.record( "GHMM::goalPdf", horizonParameters, state );
+      }
+
+      if ( runner.selected( "GHMM::topGoals" ) ) {
+        // Candidate destinations around the goals of every lane
+        typename ghmm_type::compiled_type::goal_batch_type candidates( 256, FULL_N - N );
+        for ( uint32_t i = 0; i < candidates.rows(); ++i ) {
+          candidates.row( i ) = generator.goal( i % lanes );
+          candidates.row( i ).array() += 0.1 * ( i / lanes );
+        }
+        typename ghmm_type::compiled_type::index_array best;
+        typename ghmm_type::compiled_type::value_array posteriors;
+        State state = runner.state();
+        while ( state.running() ) {
+          ghmm.topGoals( track, candidates, 10, best, posteriors );
+          keep( posteriors[0] );
+        }
+        state.counter( "goals", candidates.rows() );
+        runner.record( "GHMM::topGoals", horizonParameters, state );
+      }
+    }
+
+    // Last, it changes the model. Trajectories follow the lanes that are
+    // learned already, so that the model hardly grows while timed.
+    if ( runner.selected( "GHMM::learn" ) ) {
+      for ( uint32_t l = 0; l < config.lengths.size(); ++l ) {
+        for ( int checkpointed = 0; checkpointed < 2; ++checkpointed ) {
+          value_map learnParameters = parameters;
+          learnParameters["length"] = config.lengths[l];
+          learnParameters["checkpointed"] = checkpointed;
+
+          std::vector< trajectory_type > learned( std::min( lanes, 8u ) );
+          for ( uint32_t i = 0; i < learned.size(); ++i ) {
+            generator.trajectory( i * lanes / learned.size(), config.lengths[l], learned[i] );
+          }
+
+          State state = runner.state();
+          uint32_t i = 0;
+          while ( state.running() ) {
+            const trajectory_type & trajectory = learned[i++ % learned.size()];
+            ghmm.learn( trajectory.begin(), trajectory.end(), checkpointed );
+          }
+          state.counter( "nodes", boost::num_vertices( ghmm.graph() ) );
+          state.counter( "edges", boost::num_edges( ghmm.graph() ) );
+          runner.record( "GHMM::learn", learnParameters, state );
+        }
+      }
+    }
+  }
+
+  // Tracking through AnyGHMM, with a specialization of the dimensions of
+  // the model and with the model embedded in the widest one
+  template < int N, int FULL_N >
+  void any( Runner & runner, uint32_t nodes, double spacing )
+  {
+    typedef ghmm::AnyGHMM< double > any_type;
+    typedef LaneGenerator< double, N, FULL_N > generator_type;
+
+    if ( ! runner.selected( "AnyGHMM::update" ) ) {
+      return;
+    }
+
+    any_type::settings_type settings;
+    settings.fullSigma = any_type::matrix_type::Identity( FULL_N, FULL_N );
+    settings.observationSigma = any_type::matrix_type::Identity( N, N );
+    settings.goalSigma = any_type::matrix_type::Identity( FULL_N - N, FULL_N - N );
+    settings.insertionDistance = 1;
+    settings.epsilon = 0.01;
+    settings.statePrior = 0.001;
+    settings.transitionPrior = 0.001;
+    any_type models[] = {
+      any_type::create( N, FULL_N, settings ),
+      any_type( new ghmm::SpecializedGHMM< double, 8, 16 >( N, FULL_N, settings ) )
+    };
+
+    uint32_t lanes = std::max( 1.0, nodes / LANE_LENGTH );
+    generator_type generator( lanes, LANE_LENGTH, spacing );
+    typename generator_type::trajectory_type trajectory;
+    any_type::trajectory_type rows;
+    for ( uint32_t lane = 0; lane < lanes; ++lane ) {
+      generator.trajectory( lane, 4 * LANE_LENGTH, trajectory );
+      rows.resize( trajectory.size(), FULL_N );
+      for ( uint32_t i = 0; i < trajectory.size(); ++i ) {
+        rows.row( i ) = trajectory[i];
+      }
+      models[0].learn( rows );
+      models[1].learn( rows );
+    }
+
+    std::vector< any_type::vector_type > observations( 4 * LANE_LENGTH );
+    for ( uint32_t i = 0; i < observations.size(); ++i ) {
+      observations[i] = generator.position( lanes / 2, i * LANE_LENGTH / observations.size() );
+    }
+
+    for ( int m = 0; m < 2; ++m ) {
+      value_map parameters;
+      parameters["N"] = N;
+      parameters["FULL_N"] = FULL_N;
+      parameters["nodes"] = nodes;
+      parameters["spacing"] = spacing;
+      parameters["specialized"] = m == 0;
+
+      any_type::track_type track;
+      models[m].initTrack( track );
+      State state = runner.state();
+      uint32_t i = 0;
+      while ( state.running() ) {
+        models[m].update( track, observations[i++ % observations.size()] );
+      }
+      state.counter( "nodes", models[m].nodeCount() );
+      state.counter( "edges", models[m].edgeCount() );
+      runner.record( "AnyGHMM::update", parameters, state );
+    }
+  }
+
+  // Largest distance between the indices of two nodes a transition joins
+  template < typename GRAPH >
+  uint32_t bandwidth( const GRAPH & graph )
+  {
+    uint32_t result = 0;
+    typename boost::graph_traits< GRAPH >::edge_iterator e;
+    typename boost::graph_traits< GRAPH >::edge_iterator edgeEnd;
+    for ( boost::tie( e, edgeEnd ) = boost::edges( graph ); e != edgeEnd; ++e ) {
+      int distance = int( boost::source( *e, graph ) ) - int( boost::target( *e, graph ) );
+      result = std::max< uint32_t >( result, std::abs( distance ) );
+    }
+    return result;
+  }
+
+  // Tracking with the nodes stored in random order, as after many removals
+  // and reuses, and then in the order reorder() gives them
+  template < int N, int FULL_N >
+  void layout( Runner & runner, const Config & config, uint32_t nodes, double spacing )
+  {
+    typedef ghmm::GHMM< double, N, FULL_N > ghmm_type;
+    typedef LaneGenerator< double, N, FULL_N > generator_type;
+    typedef typename generator_type::trajectory_type trajectory_type;
+
+    if ( ! runner.selected( "Layout::update" ) && ! runner.selected( "Layout::predict" ) ) {
+      return;
+    }
+
+    uint32_t lanes = std::max( 1.0, nodes / LANE_LENGTH );
+    generator_type generator( lanes, LANE_LENGTH, spacing );
+    std::vector< trajectory_type > trajectories( lanes );
+    for ( uint32_t lane = 0; lane < lanes; ++lane ) {
+      generator.trajectory( lane, 4 * LANE_LENGTH, trajectories[lane] );
+    }
+
+    ghmm_type ghmm(
+      ghmm_type::full_matrix_type::Identity(),
+      ghmm_type::observation_matrix_type::Identity(),
+      ghmm_type::goal_matrix_type::Identity(),
+      1, 0.01,
+      0.001, 0.001
+    );
+    ghmm.learnBatch( trajectories.begin(), trajectories.end() );
+
+    std::vector< typename ghmm_type::node_type > order( boost::num_vertices( ghmm.graph() ) );
+    for ( uint32_t n = 0; n < order.size(); ++n ) {
+      order[n] = n;
+    }
+    boost::mt19937 random( 42 );
+    for ( uint32_t n = order.size(); n > 1; --n ) {
+      boost::uniform_int< uint32_t > pick( 0, n - 1 );
+      std::swap( order[n - 1], order[pick( random )] );
+    }
+
+    typedef typename ghmm_type::observation_type observation_type;
+    std::vector< 
+      observation_type, 
+      Eigen::aligned_allocator<observation_type> 
+    > observations( 4 * LANE_LENGTH );
+    for ( uint32_t i = 0; i < observations.size(); ++i ) {
+      observations[i] = generator.position( lanes / 2, i * LANE_LENGTH / observations.size() );
+    }
+    typename ghmm_type::track_type track;
+
+    for ( int reordered = 0; reordered < 2; ++reordered ) {
+      if ( reordered ) {
+        ghmm.reorder();
+      } else {
+        ghmm.reorder( order );
+      }
+
+      value_map parameters;
+      parameters["N"] = N;
+      parameters["FULL_N"] = FULL_N;
+      parameters["nodes"] = nodes;
+      parameters["spacing"] = spacing;
+      parameters["reordered"] = reordered;
+
+      if ( runner.selected( "Layout::update" ) ) {
+        ghmm.initTrack( track );
+        State state = runner.state();
+        uint32_t i = 0;
+        while ( state.running() ) {
+          ghmm.update( track, observations[i++ % observations.size()] );
+        }
+        state.counter( "nodes", boost::num_vertices( ghmm.graph() ) );
+        state.counter( "bandwidth", bandwidth( ghmm.graph() ) );
+        runner.record( "Layout::update", parameters, state );
+      }
+
+      for ( uint32_t h = 0; h < config.horizons.size(); ++h ) {
+        if ( ! runner.selected( "Layout::predict" ) ) {
+          break;
+        }
+        value_map horizonParameters = parameters;
+        horizonParameters["horizon"] = config.horizons[h];
+
+        ghmm.initTrack( track );
+        for ( uint32_t i = 0; i < observations.size() / 2; ++i ) {
+          ghmm.update( track, observations[i] );
+        }
+        State state = runner.state();
+        while ( state.running() ) {
+          ghmm.predict( track, config.horizons[h] );
+        }
+        state.counter( "bandwidth", bandwidth( ghmm.graph() ) );
+        runner.record( "Layout::predict", horizonParameters, state );
+      }
+    }
+  }
+
+  template < int N, int FULL_N >
+  void models( Runner & runner, const Config & config )
+  {
+    for ( uint32_t i = 0; i < config.nodes.size(); ++i ) {
+      for ( uint32_t j = 0; j < config.spacings.size(); ++j ) {
+        model<N, FULL_N>( runner, config, config.nodes[i], config.spacings[j] );
+        any<N, FULL_N>( runner, config.nodes[i], config.spacings[j] );
+        layout<N, FULL_N>( runner, config, config.nodes[i], config.spacings[j] );
+      }
+    }
+  }
+}
+
+
+void
+runGHMMBenchmarks( Runner & runner, const Config & config )
+{
+  // Models take long to set up, skip them when nothing uses them
+  const char * names[] = {
+    "GHMM::update",
+    "GHMM::predict",
+    "GHMM::observationPdf",
+    "GHMM::goalPdf",
+    "GHMM::topGoals",
+    "GHMM::learn",
+    "AnyGHMM::update",
+    "Layout::update",
+    "Layout::predict"
+  };
+  bool selected = false;
+  for ( uint32_t i = 0; i < sizeof( names ) / sizeof( names[0] ); ++i ) {
+    selected = selected || runner.selected( names[i] );
+  }
+  if ( ! selected ) {
+    return;
+  }
+  models<2, 4>( runner, config );
+  models<3, 6>( runner, config );
+}
+
+
+}
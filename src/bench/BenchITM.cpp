@@ -0,0 +1,102 @@
+#include "Benchmark.hpp"
+#include "Trajectories.hpp"
+#include <ghmm/ghmm_default_traits.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+namespace bench
+{
+
+
+namespace
+{
+  // Nodes a lane grows, see LaneGenerator
+  const double LANE_LENGTH = 25;
+
+  template < 
+    int N, 
+    int FULL_N, 
+    template < typename > class INDEX, 
+    template < typename > class METRIC 
+  >
+  void itm( Runner & runner, const Config & config, const std::string & name )
+  {
+    typedef ghmm::GHMMDefaultTraits< 
+      double, N, FULL_N, INDEX, ghmm::NullTrace, ghmm::RenumberingNodes, 
+      ghmm::NormalFloors, METRIC
+    > traits_type;
+    typedef typename traits_type::graph_type graph_type;
+    typedef typename traits_type::itm_type itm_type;
+    typedef typename traits_type::distance_type distance_type;
+    typedef LaneGenerator< double, N, FULL_N > generator_type;
+
+    if ( ! runner.selected( name ) ) {
+      return;
+    }
+
+    for ( uint32_t i = 0; i < config.nodes.size(); ++i ) {
+      for ( uint32_t j = 0; j < config.spacings.size(); ++j ) {
+        uint32_t lanes = std::max( 1.0, config.nodes[i] / LANE_LENGTH );
+        generator_type generator( lanes, LANE_LENGTH, config.spacings[j] );
+        std::vector< typename generator_type::trajectory_type > trajectories( lanes );
+        for ( uint32_t lane = 0; lane < lanes; ++lane ) {
+          generator.trajectory( lane, 4 * LANE_LENGTH, trajectories[lane] );
+        }
+
+        // Grown once over every lane, then timed on further passes, which
+        // mostly adapt the nodes that are there
+        graph_type graph;
+        itm_type itm(
+          graph,
+          distance_type( traits_type::full_matrix_type::Identity() ),
+          1,
+          0.01
+        );
+        for ( uint32_t lane = 0; lane < lanes; ++lane ) {
+          for ( uint32_t k = 0; k < trajectories[lane].size(); ++k ) {
+            itm( trajectories[lane][k] );
+          }
+        }
+
+        value_map parameters;
+        parameters["N"] = N;
+        parameters["FULL_N"] = FULL_N;
+        parameters["nodes"] = config.nodes[i];
+        parameters["spacing"] = config.spacings[j];
+
+        State state = runner.state();
+        uint32_t lane = 0;
+        uint32_t k = 0;
+        while ( state.running() ) {
+          itm( trajectories[lane][k] );
+          if ( ++k == trajectories[lane].size() ) {
+            lane = ( lane + 1 ) % lanes;
+            k = 0;
+          }
+        }
+        state.counter( "nodes", boost::num_vertices( graph ) );
+        state.counter( "edges", boost::num_edges( graph ) );
+        runner.record( name, parameters, state );
+      }
+    }
+  }
+}
+
+
+void
+runITMBenchmarks( Runner & runner, const Config & config )
+{
+  itm<2, 4, ghmm::LinearIndex, ghmm::MahalanobisMetric>( runner, config, "ITM/linear" );
+  itm<2, 4, ghmm::GridIndex, ghmm::MahalanobisMetric>( runner, config, "ITM/grid" );
+  itm<2, 4, ghmm::LinearIndex, ghmm::WhitenedMetric>( runner, config, "ITM/whitened" );
+  itm<2, 4, ghmm::GridIndex, ghmm::WhitenedMetric>( runner, config, "ITM/whitened-grid" );
+  itm<3, 6, ghmm::LinearIndex, ghmm::MahalanobisMetric>( runner, config, "ITM/linear" );
+  itm<3, 6, ghmm::GridIndex, ghmm::MahalanobisMetric>( runner, config, "ITM/grid" );
+  itm<3, 6, ghmm::LinearIndex, ghmm::WhitenedMetric>( runner, config, "ITM/whitened" );
+  itm<3, 6, ghmm::GridIndex, ghmm::WhitenedMetric>( runner, config, "ITM/whitened-grid" );
+}
+
+
+}
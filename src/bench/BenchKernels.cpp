@@ -0,0 +1,133 @@
+#include "Benchmark.hpp"
+#include <ghmm/ghmm_default_traits.hpp>
+#include <ghmm/GaussianKernel.hpp>
+#include <eigen3/Eigen/StdVector>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+namespace bench
+{
+
+
+namespace
+{
+  template < int D >
+  void kernels( Runner & runner )
+  {
+    typedef Eigen::Matrix<double, 1, D> vector_type;
+    typedef Eigen::Matrix<double, D, D> matrix_type;
+    typedef std::vector< vector_type, Eigen::aligned_allocator<vector_type> > vector_array;
+
+    // A fixed, well conditioned covariance and a ring of random points, so
+    // that consecutive calls do not see the same arguments
+    matrix_type sigma = matrix_type::Identity();
+    for ( int i = 0; i < D - 1; ++i ) {
+      sigma( i, i + 1 ) = sigma( i + 1, i ) = 0.25;
+    }
+    boost::mt19937 random( 7 );
+    boost::variate_generator< boost::mt19937 &, boost::uniform_real<double> >
+      uniform( random, boost::uniform_real<double>( -2, 2 ) );
+    vector_array points( 64 );
+    for ( uint32_t i = 0; i < points.size(); ++i ) {
+      for ( int d = 0; d < D; ++d ) {
+        points[i][d] = uniform();
+      }
+    }
+
+    value_map parameters;
+    parameters["dimension"] = D;
+
+    if ( runner.selected( "Gaussian" ) ) {
+      ghmm::Gaussian<double, matrix_type, vector_type> gaussian( sigma );
+      State state = runner.state();
+      uint32_t i = 0;
+      while ( state.running() ) {
+        keep( gaussian( points[i % 64], points[( i + 1 ) % 64] ) );
+        ++i;
+      }
+      runner.record( "Gaussian", parameters, state );
+    }
+
+    if ( runner.selected( "Mahalanobis" ) ) {
+      ghmm::Mahalanobis<double, matrix_type, vector_type> distance( sigma );
+      State state = runner.state();
+      uint32_t i = 0;
+      while ( state.running() ) {
+        keep( distance( points[i % 64], points[( i + 1 ) % 64] ) );
+        ++i;
+      }
+      runner.record( "Mahalanobis", parameters, state );
+    }
+
+    // One point against every point of the ring, Gaussian runs the same
+    // count of pairs one at a time
+    if ( runner.selected( "GaussianKernel" ) ) {
+      ghmm::GaussianKernel<double, matrix_type, vector_type> kernel( sigma );
+      kernel.resize( points.size() );
+      for ( uint32_t i = 0; i < points.size(); ++i ) {
+        kernel.set( i, points[i] );
+      }
+      std::vector< double > likelihoods( points.size() );
+      value_map kernelParameters = parameters;
+      kernelParameters["centroids"] = points.size();
+      State state = runner.state();
+      uint32_t i = 0;
+      while ( state.running() ) {
+        kernel.likelihoods( points[i % 64], 0, points.size(), 0, &likelihoods[0] );
+        keep( likelihoods[i % 64] );
+        ++i;
+      }
+      runner.record( "GaussianKernel", kernelParameters, state );
+    }
+  }
+
+  // Propagation through a chain with every value at the floor, which is
+  // where filtering ends up for nodes far from the observations. The
+  // values stay subnormal with a subnormal floor.
+  template < typename NUMERICS >
+  void floors( Runner & runner, const std::string & name, float floor )
+  {
+    if ( ! runner.selected( name ) ) {
+      return;
+    }
+    std::vector< float > values( 1024, floor );
+    std::vector< float > next( values.size() );
+
+    value_map parameters;
+    parameters["floor"] = floor;
+
+    State state = runner.state();
+    while ( state.running() ) {
+      typename NUMERICS::scope_type numerics;
+      next[0] = std::max( 0.5f * values[0], floor );
+      for ( uint32_t i = 1; i < values.size(); ++i ) {
+        next[i] = std::max( 0.5f * values[i] + 0.25f * values[i - 1], floor );
+      }
+      values.swap( next );
+    }
+    keep( values[values.size() / 2] );
+    runner.record( name, parameters, state );
+  }
+}
+
+
+void
+runKernelBenchmarks( Runner & runner, const Config & )
+{
+  kernels<2>( runner );
+  kernels<3>( runner );
+  kernels<4>( runner );
+  kernels<6>( runner );
+
+  floors< ghmm::NormalFloors<float> >( runner, "Floor/subnormal", 1E-40f );
+  floors< ghmm::NormalFloors<float> >( runner, "Floor/normal", ghmm::NormalFloors<float>::floor() );
+  floors< ghmm::FlushDenormals<float> >( runner, "Floor/flush", 1E-40f );
+}
+
+
+}
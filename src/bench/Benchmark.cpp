@@ -0,0 +1,189 @@
+#include "Benchmark.hpp"
+#include <time.h>
+#include <iomanip>
+#include <iostream>
+
+
+namespace bench
+{
+
+
+namespace
+{
+  volatile double sink = 0;
+
+  void writeMap( std::ostream & out, const value_map & values )
+  {
+    out << "{";
+    for ( value_map::const_iterator i = values.begin(); i != values.end(); ++i ) {
+      if ( i != values.begin() ) {
+        out << ", ";
+      }
+      out << "\"" << i->first << "\": " << i->second;
+    }
+    out << "}";
+  }
+}
+
+
+double
+now()
+{
+  timespec time;
+  clock_gettime( CLOCK_MONOTONIC, &time );
+  return time.tv_sec + time.tv_nsec * 1E-9;
+}
+
+void
+keep( double value )
+{
+  sink = sink + value;
+}
+
+//------------------------------------------------------------------------------
+
+State::State( double minTime )
+  : minTime_( minTime ),
+    iterations_( 0 ),
+    next_( 1 ),
+    start_( 0 ),
+    seconds_( 0 )
+{}
+
+bool
+State::running()
+{
+  if ( start_ == 0 ) {
+    start_ = now();
+    return true;
+  }
+  if ( ++iterations_ < next_ ) {
+    return true;
+  }
+  seconds_ = now() - start_;
+  if ( seconds_ >= minTime_ ) {
+    return false;
+  }
+  next_ *= 2;
+  return true;
+}
+
+uint64_t
+State::iterations() const
+{
+  return iterations_;
+}
+
+double
+State::seconds() const
+{
+  return seconds_;
+}
+
+void
+State::counter( const std::string & name, double value )
+{
+  counters_[name] = value;
+}
+
+const value_map &
+State::counters() const
+{
+  return counters_;
+}
+
+//------------------------------------------------------------------------------
+
+Config::Config( bool quick )
+{
+  if ( quick ) {
+    nodes.push_back( 100 );
+    lengths.push_back( 50 );
+    horizons.push_back( 10 );
+    spacings.push_back( 3.0 );
+    return;
+  }
+  nodes.push_back( 100 );
+  nodes.push_back( 1000 );
+  nodes.push_back( 5000 );
+  lengths.push_back( 50 );
+  lengths.push_back( 500 );
+  horizons.push_back( 1 );
+  horizons.push_back( 10 );
+  horizons.push_back( 50 );
+  // Lanes closer than twice the insertion distance get linked by the ITM
+  spacings.push_back( 1.2 );
+  spacings.push_back( 3.0 );
+}
+
+//------------------------------------------------------------------------------
+
+Runner::Runner( double minTime, const std::string & filter )
+  : minTime_( minTime ),
+    filter_( filter )
+{}
+
+bool
+Runner::selected( const std::string & name ) const
+{
+  return name.find( filter_ ) != std::string::npos;
+}
+
+State
+Runner::state() const
+{
+  return State( minTime_ );
+}
+
+void
+Runner::record(
+  const std::string & name,
+  const value_map & parameters,
+  const State & state
+)
+{
+  Result result;
+  result.name = name;
+  result.parameters = parameters;
+  result.counters = state.counters();
+  result.iterations = state.iterations();
+  result.seconds = state.seconds();
+  results_.push_back( result );
+
+  std::cerr << std::left << std::setw( 24 ) << name;
+  for ( value_map::const_iterator i = parameters.begin(); i != parameters.end(); ++i ) {
+    std::cerr << " " << i->first << "=" << i->second;
+  }
+  std::cerr << "  " << 1E9 * result.seconds / result.iterations << " ns" << std::endl;
+}
+
+void
+Runner::write( std::ostream & out ) const
+{
+  out << std::setprecision( 10 );
+  out << "{\n";
+  out << "  \"context\": {\"min_time\": " << minTime_ << ", \"openmp\": ";
+#ifdef _OPENMP
+  out << "true";
+#else
+  out << "false";
+#endif
+  out << "},\n";
+  out << "  \"benchmarks\": [";
+  for ( uint32_t i = 0; i < results_.size(); ++i ) {
+    const Result & r = results_[i];
+    out << ( i == 0 ? "\n" : ",\n" );
+    out << "    {\"name\": \"" << r.name << "\", \"parameters\": ";
+    writeMap( out, r.parameters );
+    out << ", \"counters\": ";
+    writeMap( out, r.counters );
+    out << ", \"iterations\": " << r.iterations
+        << ", \"seconds\": " << r.seconds
+        << ", \"ns_per_iteration\": " << 1E9 * r.seconds / r.iterations
+        << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+
+}
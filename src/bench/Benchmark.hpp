@@ -0,0 +1,101 @@
+#ifndef GHMM_BENCH_BENCHMARK_HPP_
+#define GHMM_BENCH_BENCHMARK_HPP_
+
+
+#include <stdint.h>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace bench
+{
+
+
+typedef std::map< std::string, double > value_map;
+
+
+// Times the loop it drives. The loop runs for at least the minimum time, the
+// clock is read after 1, 2, 4, ... iterations only, so that reading it does
+// not weigh on short operations.
+class State
+{
+public:
+  State( double minTime );
+
+  bool running();
+  uint64_t iterations() const;
+  double seconds() const;
+
+  // Measured values reported with the result, such as the node count
+  void counter( const std::string & name, double value );
+  const value_map & counters() const;
+private:
+  double    minTime_;
+  uint64_t  iterations_;
+  uint64_t  next_;
+  double    start_;
+  double    seconds_;
+  value_map counters_;
+};
+
+
+struct Result {
+  std::string name;
+  value_map   parameters;
+  value_map   counters;
+  uint64_t    iterations;
+  double      seconds;
+};
+
+
+// Sweeps, the quick ones only check that every benchmark runs
+struct Config {
+  Config( bool quick );
+
+  std::vector< uint32_t > nodes;
+  std::vector< uint32_t > lengths;
+  std::vector< uint32_t > horizons;
+  std::vector< double >   spacings;
+};
+
+
+// Collects results and writes them as JSON. A progress line per result goes
+// to std::cerr.
+class Runner
+{
+public:
+  Runner( double minTime, const std::string & filter );
+
+  // Whether a benchmark was selected, so that its setup can be skipped
+  bool selected( const std::string & name ) const;
+  State state() const;
+  void record(
+    const std::string & name,
+    const value_map & parameters,
+    const State & state
+  );
+  void write( std::ostream & out ) const;
+private:
+  double              minTime_;
+  std::string         filter_;
+  std::vector<Result> results_;
+};
+
+
+double now();
+
+// Keeps the compiler from dropping computations whose result is not used
+void keep( double value );
+
+
+void runKernelBenchmarks( Runner & runner, const Config & config );
+void runITMBenchmarks( Runner & runner, const Config & config );
+void runGHMMBenchmarks( Runner & runner, const Config & config );
+
+
+}
+
+
+#endif //GHMM_BENCH_BENCHMARK_HPP_
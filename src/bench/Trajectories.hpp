@@ -0,0 +1,147 @@
+#ifndef GHMM_BENCH_TRAJECTORIES_HPP_
+#define GHMM_BENCH_TRAJECTORIES_HPP_
+
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/StdVector>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <cmath>
+#include <vector>
+
+
+namespace bench
+{
+
+
+// Synthetic trajectories along straight, parallel lanes. Lanes run along the
+// first dimension and sit spacing apart on a grid across the others.
+// Observations hold the position followed by the goal, the end of the lane.
+// With unit covariances and insertion distance, a lane of length L grows
+// about L nodes, and lanes closer than two get linked. The sequence only
+// depends on the seed.
+template < typename T, int N, int FULL_N >
+class LaneGenerator
+{
+public:
+  typedef Eigen::Matrix<T, 1, FULL_N> full_observation_type;
+  typedef Eigen::Matrix<T, 1, N> observation_type;
+  typedef Eigen::Matrix<T, 1, FULL_N - N> goal_type;
+  typedef std::vector<
+    full_observation_type,
+    Eigen::aligned_allocator<full_observation_type>
+  > trajectory_type;
+
+  LaneGenerator(
+    uint32_t lanes,
+    double length,
+    double spacing,
+    double noise = 0.1,
+    uint32_t seed = 42
+  );
+
+  uint32_t lanes() const;
+
+  // Evenly spaced steps along a lane, from its start to its end
+  void trajectory( uint32_t lane, uint32_t steps, trajectory_type & result );
+  observation_type position( uint32_t lane, double s );
+  goal_type goal( uint32_t lane ) const;
+private:
+  typedef boost::variate_generator<
+    boost::mt19937 &,
+    boost::uniform_real<double>
+  > noise_type;
+
+  uint32_t        lanes_;
+  uint32_t        side_;
+  double          length_;
+  double          spacing_;
+  boost::mt19937  random_;
+  noise_type      noise_;
+
+  T across( uint32_t lane, int d ) const;
+};
+
+
+template < typename T, int N, int FULL_N >
+LaneGenerator<T, N, FULL_N>::LaneGenerator(
+  uint32_t lanes,
+  double length,
+  double spacing,
+  double noise,
+  uint32_t seed
+) : lanes_( lanes ),
+    side_( 1 ),
+    length_( length ),
+    spacing_( spacing ),
+    random_( seed ),
+    noise_( random_, boost::uniform_real<double>( -noise, noise ) )
+{
+  if ( N > 1 ) {
+    side_ = std::ceil( std::pow( double( lanes ), 1.0 / ( N - 1 ) ) - 1E-9 );
+  }
+}
+
+template < typename T, int N, int FULL_N >
+uint32_t
+LaneGenerator<T, N, FULL_N>::lanes() const
+{
+  return lanes_;
+}
+
+template < typename T, int N, int FULL_N >
+void
+LaneGenerator<T, N, FULL_N>::trajectory(
+  uint32_t lane,
+  uint32_t steps,
+  trajectory_type & result
+)
+{
+  goal_type g = goal( lane );
+  result.resize( steps );
+  for ( uint32_t i = 0; i < steps; ++i ) {
+    double s = steps > 1 ? length_ * i / ( steps - 1 ) : 0;
+    result[i].template head<N>() = position( lane, s );
+    result[i].template tail<FULL_N - N>() = g;
+  }
+}
+
+template < typename T, int N, int FULL_N >
+typename LaneGenerator<T, N, FULL_N>::observation_type
+LaneGenerator<T, N, FULL_N>::position( uint32_t lane, double s )
+{
+  observation_type result;
+  result[0] = s + noise_();
+  for ( int d = 1; d < N; ++d ) {
+    result[d] = across( lane, d ) + noise_();
+  }
+  return result;
+}
+
+template < typename T, int N, int FULL_N >
+typename LaneGenerator<T, N, FULL_N>::goal_type
+LaneGenerator<T, N, FULL_N>::goal( uint32_t lane ) const
+{
+  goal_type result = goal_type::Zero();
+  for ( int d = 0; d < FULL_N - N && d < N; ++d ) {
+    result[d] = d == 0 ? T( length_ ) : across( lane, d );
+  }
+  return result;
+}
+
+template < typename T, int N, int FULL_N >
+T
+LaneGenerator<T, N, FULL_N>::across( uint32_t lane, int d ) const
+{
+  for ( int i = 1; i < d; ++i ) {
+    lane /= side_;
+  }
+  return spacing_ * ( lane % side_ );
+}
+
+
+}
+
+
+#endif //GHMM_BENCH_TRAJECTORIES_HPP_
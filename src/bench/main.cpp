@@ -0,0 +1,63 @@
+#include "Benchmark.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+
+namespace
+{
+  void usage()
+  {
+    std::cerr 
+      << "Usage: ghmm_bench [options]\n"
+      << "  --filter TEXT     only runs benchmarks whose name contains TEXT\n"
+      << "  --min-time SEC    minimum time per benchmark, 0.2 by default\n"
+      << "  --output FILE     writes the JSON results to FILE instead of stdout\n"
+      << "  --quick           smallest sizes only\n";
+  }
+}
+
+
+int main( int argc, char ** argv )
+{
+  std::string filter;
+  std::string output;
+  double minTime = 0.2;
+  bool quick = false;
+
+  for ( int i = 1; i < argc; ++i ) {
+    std::string option = argv[i];
+    if ( option == "--quick" ) {
+      quick = true;
+    } else if ( option == "--filter" && i + 1 < argc ) {
+      filter = argv[++i];
+    } else if ( option == "--min-time" && i + 1 < argc ) {
+      minTime = std::atof( argv[++i] );
+    } else if ( option == "--output" && i + 1 < argc ) {
+      output = argv[++i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  bench::Runner runner( minTime, filter );
+  bench::Config config( quick );
+  bench::runKernelBenchmarks( runner, config );
+  bench::runITMBenchmarks( runner, config );
+  bench::runGHMMBenchmarks( runner, config );
+
+  if ( output.empty() ) {
+    runner.write( std::cout );
+  } else {
+    std::ofstream file( output.c_str() );
+    runner.write( file );
+    if ( ! file ) {
+      std::cerr << "Unable to write " << output << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
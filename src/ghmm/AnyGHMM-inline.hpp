@@ -0,0 +1,85 @@
+template < typename T >
+AnyGHMM<T>::AnyGHMM( model_type * model )
+  : model_( model )
+{}
+
+template < typename T >
+int
+AnyGHMM<T>::observationDimension() const
+{
+  return model_->observationDimension();
+}
+
+template < typename T >
+int
+AnyGHMM<T>::fullDimension() const
+{
+  return model_->fullDimension();
+}
+
+template < typename T >
+void
+AnyGHMM<T>::learn( const trajectory_type & trajectory )
+{
+  model_->learn( trajectory );
+}
+
+template < typename T >
+void
+AnyGHMM<T>::save( const std::string & path ) const
+{
+  model_->save( path );
+}
+
+template < typename T >
+void
+AnyGHMM<T>::initTrack( track_type & track ) const
+{
+  model_->initTrack( track );
+}
+
+template < typename T >
+void
+AnyGHMM<T>::update( track_type & track, const vector_type & o ) const
+{
+  model_->update( track, o );
+}
+
+template < typename T >
+void
+AnyGHMM<T>::predict( track_type & track, uint8_t horizon ) const
+{
+  model_->predict( track, horizon );
+}
+
+template < typename T >
+typename AnyGHMM<T>::value_type
+AnyGHMM<T>::observationPdf(
+  const track_type & track,
+  uint32_t t,
+  const vector_type & o
+) const
+{
+  return model_->observationPdf( track, t, o );
+}
+
+template < typename T >
+typename AnyGHMM<T>::value_type
+AnyGHMM<T>::goalPdf( const track_type & track, const vector_type & g ) const
+{
+  return model_->goalPdf( track, g );
+}
+
+template < typename T >
+uint32_t
+AnyGHMM<T>::nodeCount() const
+{
+  return model_->nodeCount();
+}
+
+template < typename T >
+uint32_t
+AnyGHMM<T>::edgeCount() const
+{
+  return model_->edgeCount();
+}
@@ -0,0 +1,107 @@
+#include "AnyGHMM.hpp"
+#include "SpecializedGHMM.hpp"
+#include <stdexcept>
+
+
+namespace ghmm
+{
+
+
+namespace
+{
+  // Calls visitor.visit< SPECIALIZATION >( exact ) with the specialization
+  // models of these dimensions use. Exact ones come first, anything else is
+  // embedded in the widest one.
+  template < typename T, typename VISITOR >
+  typename VISITOR::result_type
+  dispatch( int n, int fullN, VISITOR & visitor )
+  {
+    if ( n == 1 && fullN == 2 ) {
+      return visitor.template visit< SpecializedGHMM<T, 1, 2> >( true );
+    }
+    if ( n == 2 && fullN == 4 ) {
+      return visitor.template visit< SpecializedGHMM<T, 2, 4> >( true );
+    }
+    if ( n == 3 && fullN == 6 ) {
+      return visitor.template visit< SpecializedGHMM<T, 3, 6> >( true );
+    }
+    if ( n == 4 && fullN == 6 ) {
+      return visitor.template visit< SpecializedGHMM<T, 4, 6> >( true );
+    }
+    return visitor.template visit< SpecializedGHMM<T, 8, 16> >( false );
+  }
+
+  // Builds the model, from settings or from an image
+  template < typename T, typename ARGUMENTS >
+  struct factory
+  {
+    typedef typename AnyGHMM<T>::model_type * result_type;
+
+    factory( int n, int fullN, const ARGUMENTS & arguments )
+      : n( n ), fullN( fullN ), arguments( arguments )
+    {}
+
+    template < typename SPECIALIZATION >
+    result_type visit( bool )
+    {
+      return new SPECIALIZATION( n, fullN, arguments );
+    }
+
+    int n;
+    int fullN;
+    const ARGUMENTS & arguments;
+  };
+
+  // Only tells whether the specialization is exact
+  struct checker
+  {
+    typedef bool result_type;
+
+    template < typename SPECIALIZATION >
+    result_type visit( bool exact ) const
+    {
+      return exact;
+    }
+  };
+}
+
+
+template < typename T >
+AnyGHMM<T>
+AnyGHMM<T>::create(
+  int observationDimension,
+  int fullDimension,
+  const settings_type & settings
+)
+{
+  factory< T, settings_type > visitor( observationDimension, fullDimension, settings );
+  return AnyGHMM( dispatch<T>( observationDimension, fullDimension, visitor ) );
+}
+
+template < typename T >
+AnyGHMM<T>
+AnyGHMM<T>::load(
+  const std::string & path,
+  int observationDimension,
+  int fullDimension
+)
+{
+  ModelImage image = ModelImage::map( path );
+  factory< T, ModelImage > visitor( observationDimension, fullDimension, image );
+  return AnyGHMM( dispatch<T>( observationDimension, fullDimension, visitor ) );
+}
+
+template < typename T >
+bool
+AnyGHMM<T>::specialized( int observationDimension, int fullDimension )
+{
+  checker visitor;
+  return dispatch<T>( observationDimension, fullDimension, visitor );
+}
+
+
+template class AnyGHMM<float>;
+template class AnyGHMM<double>;
+
+
+}
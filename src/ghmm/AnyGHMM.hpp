@@ -0,0 +1,127 @@
+#ifndef GHMM_ANY_GHMM_HPP_
+#define GHMM_ANY_GHMM_HPP_
+
+
+#include "TrackState.hpp"
+#include <eigen3/Eigen/Core>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+#include <string>
+
+
+namespace ghmm
+{
+
+
+// GHMM whose dimensions are chosen at run time. Calls go through one virtual
+// call to a GHMM of fixed dimensions, see SpecializedGHMM, and only copy the
+// vectors they are given, so their cost does not depend on the model.
+//
+// create and load are compiled in the ghmm_any library, for float and
+// double, with specializations of the most common dimensions. Any other
+// dimensions are embedded in the widest specialization: its extra
+// dimensions are zero in every observation and centroid, independent and
+// of unit variance, so they change no distance nor density. Including
+// AnyGHMM.hpp does not compile any GHMM.
+template < typename T >
+class AnyGHMM
+{
+public:
+  typedef T value_type;
+  typedef Eigen::Matrix< value_type, 1, Eigen::Dynamic > vector_type;
+  typedef Eigen::Matrix< value_type, Eigen::Dynamic, Eigen::Dynamic > matrix_type;
+  // One observation per row
+  typedef Eigen::Matrix<
+      value_type, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor
+    > trajectory_type;
+  typedef TrackState< value_type > track_type;
+
+  // Arguments of the GHMM constructor
+  struct settings_type {
+    matrix_type fullSigma;
+    matrix_type observationSigma;
+    matrix_type goalSigma;
+    value_type insertionDistance;
+    value_type epsilon;
+    value_type statePrior;
+    value_type transitionPrior;
+  };
+
+  // What a specialization implements. Vectors have the dimensions of the
+  // model, observations come first in full observations.
+  class model_type
+  {
+  public:
+    virtual ~model_type() {}
+    virtual int observationDimension() const = 0;
+    virtual int fullDimension() const = 0;
+    virtual void learn( const trajectory_type & trajectory ) = 0;
+    virtual void save( const std::string & path ) const = 0;
+    virtual void initTrack( track_type & track ) const = 0;
+    virtual void update( track_type & track, const vector_type & o ) const = 0;
+    virtual void predict( track_type & track, uint8_t horizon ) const = 0;
+    virtual value_type observationPdf(
+      const track_type & track,
+      uint32_t t,
+      const vector_type & o
+    ) const = 0;
+    virtual value_type goalPdf(
+      const track_type & track,
+      const vector_type & g
+    ) const = 0;
+    virtual uint32_t nodeCount() const = 0;
+    virtual uint32_t edgeCount() const = 0;
+  };
+
+  // Takes ownership of the model. Copies share it.
+  explicit AnyGHMM( model_type * model );
+
+  // Throws std::invalid_argument when the dimensions are not supported or
+  // the covariances do not match them
+  static AnyGHMM create(
+    int observationDimension,
+    int fullDimension,
+    const settings_type & settings
+  );
+  // Restores a model saved by an AnyGHMM of the same dimensions
+  static AnyGHMM load(
+    const std::string & path,
+    int observationDimension,
+    int fullDimension
+  );
+  // Whether create has a specialization of exactly these dimensions
+  static bool specialized( int observationDimension, int fullDimension );
+
+  int observationDimension() const;
+  int fullDimension() const;
+
+  void learn( const trajectory_type & trajectory );
+  void save( const std::string & path ) const;
+
+  void initTrack( track_type & track ) const;
+  void update( track_type & track, const vector_type & o ) const;
+  void predict( track_type & track, uint8_t horizon ) const;
+  value_type observationPdf(
+    const track_type & track,
+    uint32_t t,
+    const vector_type & o
+  ) const;
+  value_type goalPdf(
+    const track_type & track,
+    const vector_type & g
+  ) const;
+
+  uint32_t nodeCount() const;
+  uint32_t edgeCount() const;
+private:
+  boost::shared_ptr< model_type > model_;
+};
+
+
+#include "AnyGHMM-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_ANY_GHMM_HPP_
@@ -0,0 +1,851 @@
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::CompiledGHMM(
+  const graph_type & graph, 
+  const observation_matrix_type & observationSigma, 
+  const goal_matrix_type & goalSigma 
+) : image_( build( graph, observationSigma, goalSigma ) )
+{
+  bind();
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::CompiledGHMM( const ModelImage & image )
+  : image_( image )
+{
+  bind();
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::load( const std::string & path )
+{
+  return CompiledGHMM( ModelImage::map( path ) );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::save( const std::string & path ) const
+{
+  image_.save( path );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+ModelImage
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::build(
+  const graph_type & graph, 
+  const observation_matrix_type & observationSigma, 
+  const goal_matrix_type & goalSigma,
+  const learning_type * learning
+)
+{
+  uint32_t nodeCount = boost::num_vertices( graph );
+  uint32_t edgeCount = boost::num_edges( graph );
+
+  // Grid cells of every node, and the nodes sorted by cell
+  observation_matrix_type whitening = 
+    Eigen::LLT<observation_matrix_type>( observationSigma.inverse() ).matrixL();
+  std::vector<int32_t> nodeCells( N * nodeCount );
+  index_array cellNodes( nodeCount );
+
+  typename boost::graph_traits<graph_type>::vertex_iterator n;
+  typename boost::graph_traits<graph_type>::vertex_iterator nodeEnd;
+
+  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph );
+        n != nodeEnd; ++n
+  ) {
+    uint32_t i = boost::get( boost::vertex_index, graph, *n );
+    cell_type c = cellOf( whitening, GHMM_TRAITS::toObservation( graph[*n].centroid ) );
+    std::copy( c.data(), c.data() + N, &nodeCells[N * i] );
+    cellNodes[i] = i;
+  }
+  if ( nodeCount > 0 ) {
+    std::sort( cellNodes.begin(), cellNodes.end(), cell_order( &nodeCells[0] ) );
+  }
+  uint32_t cellCount = 0;
+  for ( uint32_t i = 0; i < nodeCount; ++i ) {
+    if (    i == 0 
+         || cellLess( &nodeCells[N * cellNodes[i - 1]], &nodeCells[N * cellNodes[i]] ) 
+    ) {
+      ++cellCount;
+    }
+  }
+
+  ModelImage::header_type header;
+  header.valueSize = sizeof( value_type );
+  header.observationDimension = N;
+  header.fullDimension = FULL_N;
+  header.trajectoryCount = learning ? learning->trajectoryCount : 0;
+
+  uint64_t counts[ModelImage::SECTION_COUNT] = {
+    N * N,
+    goal_dimension * goal_dimension,
+    FULL_N * nodeCount,
+    nodeCount,
+    nodeCount + 1,
+    edgeCount,
+    edgeCount,
+    nodeCount + 1,
+    edgeCount,
+    edgeCount,
+    N * cellCount,
+    cellCount + 1,
+    nodeCount,
+    learning ? FULL_N * FULL_N : 0u,
+    learning ? 4u : 0u,
+    learning ? nodeCount : 0,
+    learning ? edgeCount : 0,
+    learning ? edgeCount : 0
+  };
+  uint32_t sizes[ModelImage::SECTION_COUNT];
+  std::fill( sizes, sizes + ModelImage::SECTION_COUNT, sizeof( value_type ) );
+  sizes[ModelImage::IN_OFFSETS] = sizeof( uint32_t );
+  sizes[ModelImage::SOURCES] = sizeof( uint32_t );
+  sizes[ModelImage::OUT_OFFSETS] = sizeof( uint32_t );
+  sizes[ModelImage::TARGETS] = sizeof( uint32_t );
+  sizes[ModelImage::CELLS] = sizeof( int32_t );
+  sizes[ModelImage::CELL_OFFSETS] = sizeof( uint32_t );
+  sizes[ModelImage::CELL_NODES] = sizeof( uint32_t );
+
+  ModelImage image( header, counts, sizes );
+
+  value_type * values = image.section<value_type>( ModelImage::OBSERVATION_SIGMA );
+  for ( int i = 0; i < N; ++i ) {
+    for ( int j = 0; j < N; ++j ) {
+      *values++ = observationSigma( i, j );
+    }
+  }
+  values = image.section<value_type>( ModelImage::GOAL_SIGMA );
+  for ( int i = 0; i < goal_dimension; ++i ) {
+    for ( int j = 0; j < goal_dimension; ++j ) {
+      *values++ = goalSigma( i, j );
+    }
+  }
+
+  value_type * centroids   = image.section<value_type>( ModelImage::CENTROIDS );
+  value_type * prior       = image.section<value_type>( ModelImage::PRIOR );
+  uint32_t * offsets       = image.section<uint32_t>( ModelImage::IN_OFFSETS );
+  uint32_t * sources       = image.section<uint32_t>( ModelImage::SOURCES );
+  value_type * transitions = image.section<value_type>( ModelImage::TRANSITIONS );
+  uint32_t * outOffsets    = image.section<uint32_t>( ModelImage::OUT_OFFSETS );
+  uint32_t * targets       = image.section<uint32_t>( ModelImage::TARGETS );
+  value_type * outTransitions = image.section<value_type>( ModelImage::OUT_TRANSITIONS );
+  value_type * probabilitySums = image.section<value_type>( ModelImage::PROBABILITY_SUMS );
+  value_type * numeratorSums = image.section<value_type>( ModelImage::NUMERATOR_SUMS );
+  value_type * denominatorSums = image.section<value_type>( ModelImage::DENOMINATOR_SUMS );
+
+  uint32_t in = 0;
+  uint32_t out = 0;
+
+  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph );
+        n != nodeEnd; ++n
+  ) {
+    uint32_t i = boost::get( boost::vertex_index, graph, *n );
+    offsets[i] = in;
+    outOffsets[i] = out;
+    prior[i] = graph[*n].probability;
+    if ( learning ) {
+      probabilitySums[i] = graph[*n].probabilitySum;
+    }
+
+    // Observation dimensions come first, then the goal ones
+    for ( int d = 0; d < FULL_N; ++d ) {
+      centroids[d * nodeCount + i] = graph[*n].centroid[d];
+    }
+
+    typename boost::graph_traits<graph_type>::in_edge_iterator parentEdge;
+    typename boost::graph_traits<graph_type>::in_edge_iterator parentEdgeEnd;
+
+    for ( boost::tie( parentEdge, parentEdgeEnd ) = boost::in_edges( *n, graph ); 
+          parentEdge != parentEdgeEnd; ++parentEdge, ++in
+    ) {
+      sources[in] = 
+        boost::get( boost::vertex_index, graph, boost::source( *parentEdge, graph ) );
+      transitions[in] = graph[*parentEdge].probability;
+    }
+
+    typename boost::graph_traits<graph_type>::out_edge_iterator childEdge;
+    typename boost::graph_traits<graph_type>::out_edge_iterator childEdgeEnd;
+
+    for ( boost::tie( childEdge, childEdgeEnd ) = boost::out_edges( *n, graph ); 
+          childEdge != childEdgeEnd; ++childEdge, ++out
+    ) {
+      targets[out] = 
+        boost::get( boost::vertex_index, graph, boost::target( *childEdge, graph ) );
+      outTransitions[out] = graph[*childEdge].probability;
+      if ( learning ) {
+        numeratorSums[out] = graph[*childEdge].numeratorSum;
+        denominatorSums[out] = graph[*childEdge].denominatorSum;
+      }
+    }
+  }
+  offsets[nodeCount] = in;
+  outOffsets[nodeCount] = out;
+
+  int32_t * cells = image.section<int32_t>( ModelImage::CELLS );
+  uint32_t * cellOffsets = image.section<uint32_t>( ModelImage::CELL_OFFSETS );
+  std::copy( cellNodes.begin(), cellNodes.end(), image.section<uint32_t>( ModelImage::CELL_NODES ) );
+  uint32_t cell = 0;
+  for ( uint32_t i = 0; i < nodeCount; ++i ) {
+    const int32_t * c = &nodeCells[N * cellNodes[i]];
+    if ( i == 0 || cellLess( &nodeCells[N * cellNodes[i - 1]], c ) ) {
+      std::copy( c, c + N, cells + N * cell );
+      cellOffsets[cell++] = i;
+    }
+  }
+  cellOffsets[cellCount] = nodeCount;
+
+  if ( learning ) {
+    values = image.section<value_type>( ModelImage::FULL_SIGMA );
+    for ( int i = 0; i < FULL_N; ++i ) {
+      for ( int j = 0; j < FULL_N; ++j ) {
+        *values++ = learning->fullSigma( i, j );
+      }
+    }
+    values = image.section<value_type>( ModelImage::PARAMETERS );
+    values[0] = learning->insertionDistance;
+    values[1] = learning->epsilon;
+    values[2] = learning->statePrior;
+    values[3] = learning->transitionPrior;
+  }
+  return image;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+const ModelImage &
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::image() const
+{
+  return image_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::bind()
+{
+  const ModelImage::header_type & header = image_.header();
+  if (    header.valueSize != sizeof( value_type )
+       || header.observationDimension != N
+       || header.fullDimension != FULL_N
+  ) {
+    throw std::runtime_error( "Model file does not match the model type" );
+  }
+
+  nodeCount_ = image_.count( ModelImage::PRIOR );
+  edgeCount_ = image_.count( ModelImage::SOURCES );
+  cellCount_ = image_.count( ModelImage::CELL_OFFSETS ) - 1;
+  if (    image_.count( ModelImage::CENTROIDS ) != uint64_t( FULL_N ) * nodeCount_
+       || image_.count( ModelImage::IN_OFFSETS ) != nodeCount_ + 1
+       || image_.count( ModelImage::TRANSITIONS ) != edgeCount_
+       || image_.count( ModelImage::OUT_OFFSETS ) != nodeCount_ + 1
+       || image_.count( ModelImage::TARGETS ) != edgeCount_
+       || image_.count( ModelImage::OUT_TRANSITIONS ) != edgeCount_
+       || image_.count( ModelImage::CELL_OFFSETS ) == 0
+       || image_.count( ModelImage::CELLS ) != uint64_t( N ) * cellCount_
+       || image_.count( ModelImage::CELL_NODES ) != nodeCount_
+  ) {
+    throw std::runtime_error( "Model file sections are inconsistent" );
+  }
+
+  offsets_ = image_.section<uint32_t>( ModelImage::IN_OFFSETS );
+  sources_ = image_.section<uint32_t>( ModelImage::SOURCES );
+  transitions_ = image_.section<value_type>( ModelImage::TRANSITIONS );
+  outOffsets_ = image_.section<uint32_t>( ModelImage::OUT_OFFSETS );
+  targets_ = image_.section<uint32_t>( ModelImage::TARGETS );
+  outTransitions_ = image_.section<value_type>( ModelImage::OUT_TRANSITIONS );
+  prior_ = image_.section<value_type>( ModelImage::PRIOR );
+  observationCentroids_ = image_.section<value_type>( ModelImage::CENTROIDS );
+  goalCentroids_ = observationCentroids_ + N * nodeCount_;
+  cells_ = image_.section<int32_t>( ModelImage::CELLS );
+  cellOffsets_ = image_.section<uint32_t>( ModelImage::CELL_OFFSETS );
+  cellNodes_ = image_.section<uint32_t>( ModelImage::CELL_NODES );
+
+  // Tracking indexes with these without checking
+  checkOffsets( offsets_, nodeCount_, edgeCount_ );
+  checkOffsets( outOffsets_, nodeCount_, edgeCount_ );
+  checkOffsets( cellOffsets_, cellCount_, nodeCount_ );
+  checkIndices( sources_, edgeCount_, nodeCount_ );
+  checkIndices( targets_, edgeCount_, nodeCount_ );
+  checkIndices( cellNodes_, nodeCount_, nodeCount_ );
+
+  observationKernel_ = observation_kernel_type( 
+    image_.matrix<observation_matrix_type>( ModelImage::OBSERVATION_SIGMA ) 
+  );
+  observationKernel_.assign( observationCentroids_, nodeCount_, nodeCount_ );
+  goalKernel_ = goal_kernel_type( 
+    image_.matrix<goal_matrix_type>( ModelImage::GOAL_SIGMA ) 
+  );
+  goalKernel_.assign( goalCentroids_, nodeCount_, nodeCount_ );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::checkOffsets( 
+  const uint32_t * offsets, 
+  uint32_t count, 
+  uint32_t last 
+)
+{
+  if ( offsets[0] != 0 || offsets[count] != last ) {
+    throw std::runtime_error( "Model file has invalid offsets" );
+  }
+  for ( uint32_t i = 0; i < count; ++i ) {
+    if ( offsets[i] > offsets[i + 1] ) {
+      throw std::runtime_error( "Model file has invalid offsets" );
+    }
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::checkIndices( 
+  const uint32_t * indices, 
+  uint32_t count, 
+  uint32_t bound 
+)
+{
+  for ( uint32_t i = 0; i < count; ++i ) {
+    if ( indices[i] >= bound ) {
+      throw std::runtime_error( "Model file has an invalid node index" );
+    }
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::initTrack( track_type & track ) const
+{
+  track.nodeCount = nodeCount_;
+  track.estimations.assign( prior_, prior_ + nodeCount_ );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::update( 
+  track_type & track, 
+  const observation_type & o
+) const
+{
+  typename numerics_type::scope_type numerics;
+  track.likelihoods.resize( nodeCount_ );
+  observationLikelihoods( o, nodeCount_ == 0 ? 0 : &track.likelihoods[0] );
+
+  // The new belief is built in the second row, the first one still holds
+  // the previous belief
+  track.estimations.resize( 2 * nodeCount_ );
+
+  value_type total = 0;
+
+  for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+    value_type & estimation = track.estimations[nodeCount_ + n];
+    estimation = 0;
+    for ( uint32_t e = offsets_[n]; e < offsets_[n + 1]; ++e ) {
+      estimation +=   track.estimations[sources_[e]] 
+                    * transitions_[e] 
+                    * track.likelihoods[n];
+    }
+    if ( estimation < numerics_type::floor() ) {
+      estimation = numerics_type::floor();
+    }
+    total += estimation;
+  }
+
+  assert( total == total );
+  assert( total > 0 );
+
+  for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+    track.estimations[n] = track.estimations[nodeCount_ + n] / total;
+  }
+  track.estimations.resize( nodeCount_ );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::update( 
+  track_type & track, 
+  const observation_type & o,
+  value_type gate
+) const
+{
+  typename numerics_type::scope_type numerics;
+  gateCandidates( o, gate, track.nodes );
+  track.likelihoods.resize( track.nodes.size() );
+
+  observation_type whitened = observationKernel_.whiten( o );
+  uint32_t inside = 0;
+  for ( uint32_t i = 0; i < track.nodes.size(); ++i ) {
+    uint32_t n = track.nodes[i];
+    value_type distance = observationKernel_.distance( whitened, n );
+    if ( distance <= gate ) {
+      track.nodes[inside] = n;
+      track.likelihoods[inside] = exp( - 0.5 * distance ) + numerics_type::floor();
+      ++inside;
+    }
+  }
+  track.nodes.resize( inside );
+  track.likelihoods.resize( inside );
+
+  if ( inside == 0 ) {
+    update( track, o );
+    return 0;
+  }
+
+  // Nodes outside of the gate are approximated by the floor, their share of
+  // the total is accounted for without visiting them. The exact update
+  // would give them more, up to the bound returned below.
+  value_type total = ( nodeCount_ - inside ) * numerics_type::floor();
+  value_type predicted = 0;
+
+  for ( uint32_t i = 0; i < inside; ++i ) {
+    uint32_t n = track.nodes[i];
+    value_type estimation = 0;
+    for ( uint32_t e = offsets_[n]; e < offsets_[n + 1]; ++e ) {
+      value_type tmp = track.estimations[sources_[e]] * transitions_[e];
+      predicted += tmp;
+      estimation += tmp * track.likelihoods[i];
+    }
+    if ( estimation < numerics_type::floor() ) {
+      estimation = numerics_type::floor();
+    }
+    track.likelihoods[i] = estimation;
+    total += estimation;
+  }
+
+  assert( total == total );
+  assert( total > 0 );
+
+  track.estimations.resize( nodeCount_ );
+  std::fill( track.estimations.begin(), track.estimations.end(), numerics_type::floor() / total );
+  for ( uint32_t i = 0; i < inside; ++i ) {
+    track.estimations[track.nodes[i]] = track.likelihoods[i] / total;
+  }
+
+  // Nodes outside of the gate have at most the likelihood at its border
+  value_type dropped =   ( exp( - 0.5 * gate ) + numerics_type::floor() ) 
+                       * std::max( value_type( 0 ), 1 - predicted );
+  return dropped / ( total + dropped );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::predict( track_type & track, uint8_t horizon ) const
+{
+  typename numerics_type::scope_type numerics;
+  track.estimations.resize( ( horizon + 1 ) * nodeCount_ );
+
+  for ( uint32_t t = 1; t <= horizon; ++t ) {
+    uint32_t previous = ( t - 1 ) * nodeCount_;
+    uint32_t current = t * nodeCount_;
+    for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+      value_type & estimation = track.estimations[current + n];
+      estimation = 0;
+      for ( uint32_t e = offsets_[n]; e < offsets_[n + 1]; ++e ) {
+        estimation +=   track.estimations[previous + sources_[e]] 
+                      * transitions_[e];
+      }
+    }
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::predict( 
+  track_type & track, 
+  uint8_t horizon,
+  value_type threshold
+) const
+{
+  typename numerics_type::scope_type numerics;
+  track.estimations.resize( nodeCount_ );
+  track.estimations.resize( ( horizon + 1 ) * nodeCount_, 0 );
+
+  // The active nodes of the current step come first in the scratch list,
+  // the nodes reached from them are appended behind
+  value_type pruned = 0;
+  track.nodes.clear();
+  for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+    if ( track.estimations[n] > threshold ) {
+      track.nodes.push_back( n );
+    } else {
+      pruned += track.estimations[n];
+    }
+  }
+
+  for ( uint32_t t = 1; t <= horizon; ++t ) {
+    const value_type * previous = &track.estimations[( t - 1 ) * nodeCount_];
+    value_type * current = &track.estimations[t * nodeCount_];
+    uint32_t active = track.nodes.size();
+
+    for ( uint32_t i = 0; i < active; ++i ) {
+      uint32_t n = track.nodes[i];
+      for ( uint32_t e = outOffsets_[n]; e < outOffsets_[n + 1]; ++e ) {
+        uint32_t n2 = targets_[e];
+        value_type tmp = previous[n] * outTransitions_[e];
+        // Underflows would list a node twice
+        if ( tmp == 0 ) {
+          continue;
+        }
+        if ( current[n2] == 0 ) {
+          track.nodes.push_back( n2 );
+        }
+        current[n2] += tmp;
+      }
+    }
+
+    if ( t == horizon ) {
+      break;
+    }
+
+    uint32_t next = 0;
+    for ( uint32_t i = active; i < track.nodes.size(); ++i ) {
+      uint32_t n = track.nodes[i];
+      if ( current[n] > threshold ) {
+        track.nodes[next++] = n;
+      } else {
+        pruned += current[n];
+      }
+    }
+    track.nodes.resize( next );
+  }
+  return pruned;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::value_type 
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::observationPdf(
+  const track_type & track, 
+  uint32_t t, 
+  const observation_type & o 
+) const 
+{
+  // Gaussians are evaluated a block of nodes at a time, on the stack
+  const uint32_t block = 64;
+  value_type gaussians[block];
+  value_type result = numerics_type::floor();
+  for ( uint32_t first = 0; first < nodeCount_; first += block ) {
+    uint32_t count = std::min( block, nodeCount_ - first );
+    observationKernel_.likelihoods( o, first, count, numerics_type::floor(), gaussians );
+    for ( uint32_t i = 0; i < count; ++i ) {
+      result += track.estimation( t, first + i ) * gaussians[i] + numerics_type::floor();
+    }
+  }
+  assert( result == result );
+  assert( result  > 0 );
+  return result;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::value_type 
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::goalPdf(
+  const track_type & track, 
+  const goal_type & g 
+) const 
+{
+  const uint32_t block = 64;
+  value_type gaussians[block];
+  value_type result = numerics_type::floor();
+  for ( uint32_t first = 0; first < nodeCount_; first += block ) {
+    uint32_t count = std::min( block, nodeCount_ - first );
+    goalKernel_.likelihoods( g, first, count, 0, gaussians );
+    for ( uint32_t i = 0; i < count; ++i ) {
+      result += track.belief( first + i ) * gaussians[i] + numerics_type::floor();
+    }
+  }
+  assert( result == result );
+  assert( result  > 0 );
+  return result;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::initTracks( 
+  belief_matrix_type & beliefs, 
+  uint32_t first 
+) const
+{
+  for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+    beliefs.row( n ).tail( beliefs.cols() - first ).setConstant( prior_[n] );
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::transition( 
+  const belief_matrix_type & from, 
+  belief_matrix_type & to 
+) const
+{
+  // Sparse times dense product, every edge scales a whole row of tracks
+  to.setZero( nodeCount_, from.cols() );
+  for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+    for ( uint32_t e = offsets_[n]; e < offsets_[n + 1]; ++e ) {
+      to.row( n ) += transitions_[e] * from.row( sources_[e] );
+    }
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::observationProbabilities(
+  const observation_batch_type & o,
+  belief_matrix_type & result
+) const
+{
+  // Observations are whitened a block of tracks at a time, on the stack,
+  // once for all nodes
+  const int block = 64;
+  Eigen::Matrix< value_type, block, N > whitened;
+  uint32_t tracks = o.rows();
+  result.setZero( nodeCount_, tracks );
+  for ( uint32_t first = 0; first < tracks; first += block ) {
+    uint32_t count = std::min< uint32_t >( block, tracks - first );
+    whitened.topRows( count ).noalias() = 
+      o.middleRows( first, count ).lazyProduct( observationKernel_.whitening() );
+    for ( int d = 0; d < N; ++d ) {
+      const value_type * centroids = observationKernel_.centroids( d );
+      for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+        result.row( n ).segment( first, count ) += 
+          ( whitened.col( d ).head( count ).array() - centroids[n] ).square().matrix().transpose();
+      }
+    }
+  }
+  result = ( - 0.5 * result.array() ).exp() + numerics_type::floor();
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::observationPdf(
+  const track_type & track, 
+  const index_array & horizons, 
+  const observation_batch_type & o, 
+  density_matrix_type & result 
+) const 
+{
+  observation_batch_type whitened = o * observationKernel_.whitening();
+  typename Eigen::Array< value_type, Eigen::Dynamic, 1 > gaussian;
+  result.setConstant( o.rows(), horizons.size(), numerics_type::floor() );
+
+  for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+    bool reachable = false;
+    for ( uint32_t h = 0; h < horizons.size(); ++h ) {
+      reachable = reachable || track.estimation( horizons[h], n ) != 0;
+    }
+    if ( ! reachable ) {
+      // Nodes pruned by a sparse prediction only add the floor
+      result.array() += numerics_type::floor();
+      continue;
+    }
+    gaussians( whitened, observationKernel_, n, gaussian );
+    gaussian += numerics_type::floor();
+    for ( uint32_t h = 0; h < horizons.size(); ++h ) {
+      result.col( h ).array() += track.estimation( horizons[h], n ) * gaussian + numerics_type::floor();
+    }
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::goalPdf(
+  const track_type & track, 
+  const goal_batch_type & g, 
+  density_matrix_type & result 
+) const 
+{
+  // Goals are whitened once for all nodes
+  goal_batch_type whitened = g * goalKernel_.whitening();
+  typename Eigen::Array< value_type, Eigen::Dynamic, 1 > gaussian;
+  result.setConstant( g.rows(), 1, numerics_type::floor() );
+
+  for ( uint32_t n = 0; n < nodeCount_; ++n ) {
+    gaussians( whitened, goalKernel_, n, gaussian );
+    result.col( 0 ).array() += track.belief( n ) * gaussian + numerics_type::floor();
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::goalPosterior(
+  const track_type & track, 
+  const goal_batch_type & g, 
+  density_matrix_type & result 
+) const 
+{
+  goalPdf( track, g, result );
+  if ( result.rows() > 0 ) {
+    result /= result.sum();
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::topGoals(
+  const track_type & track, 
+  const goal_batch_type & g, 
+  uint32_t k, 
+  index_array & goals, 
+  value_array & posteriors 
+) const 
+{
+  density_matrix_type densities;
+  goalPosterior( track, g, densities );
+
+  k = std::min< uint32_t >( k, g.rows() );
+  goals.resize( g.rows() );
+  for ( uint32_t q = 0; q < goals.size(); ++q ) {
+    goals[q] = q;
+  }
+  std::partial_sort( 
+    goals.begin(), goals.begin() + k, goals.end(), density_order( densities ) 
+  );
+  goals.resize( k );
+
+  posteriors.resize( k );
+  for ( uint32_t i = 0; i < k; ++i ) {
+    posteriors[i] = densities( goals[i], 0 );
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint32_t
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::nodeCount() const
+{
+  return nodeCount_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint32_t
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::edgeCount() const
+{
+  return edgeCount_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::observationLikelihoods(
+  const observation_type & o,
+  value_type * result
+) const
+{
+  observationKernel_.likelihoods( o, 0, nodeCount_, numerics_type::floor(), result );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::observationLogLikelihoods(
+  const observation_type & o,
+  value_type * result
+) const
+{
+  observationKernel_.logLikelihoods( o, 0, nodeCount_, result );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::cell_type
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::cellOf( 
+  const observation_matrix_type & whitening, 
+  const observation_type & o 
+)
+{
+  observation_type w = o * whitening;
+  cell_type result;
+  for ( int i = 0; i < N; ++i ) {
+    result[i] = static_cast<int32_t>( std::floor( w[i] ) );
+  }
+  return result;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint32_t
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::findCell( const cell_type & c ) const
+{
+  uint32_t low = 0;
+  uint32_t high = cellCount_;
+  while ( low < high ) {
+    uint32_t middle = ( low + high ) / 2;
+    if ( cellLess( cells_ + N * middle, c.data() ) ) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if ( low < cellCount_ && ! cellLess( c.data(), cells_ + N * low ) ) {
+    return low;
+  }
+  return cellCount_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+bool
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::cellLess( const int32_t * a, const int32_t * b )
+{
+  return std::lexicographical_compare( a, a + N, b, b + N );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::gateCandidates(
+  const observation_type & o,
+  value_type gate,
+  index_array & nodes
+) const
+{
+  // Every node within the gate lies in the box of cells covering the ball of
+  // radius sqrt( gate ) around the whitened observation
+  value_type radius = std::sqrt( gate );
+  observation_type w = observationKernel_.whiten( o );
+  cell_type low;
+  cell_type high;
+  double boxSize = 1;
+  for ( int i = 0; i < N; ++i ) {
+    low[i] = static_cast<int32_t>( std::floor( w[i] - radius ) );
+    high[i] = static_cast<int32_t>( std::floor( w[i] + radius ) );
+    boxSize *= high[i] - low[i] + 1.0;
+  }
+
+  nodes.clear();
+  if ( boxSize > cellCount_ ) {
+    for ( uint32_t cell = 0; cell < cellCount_; ++cell ) {
+      Eigen::Map<const cell_type> c( cells_ + N * cell );
+      if ( ( c.array() >= low.array() ).all() && ( c.array() <= high.array() ).all() ) {
+        nodes.insert( 
+          nodes.end(), cellNodes_ + cellOffsets_[cell], cellNodes_ + cellOffsets_[cell + 1] 
+        );
+      }
+    }
+    return;
+  }
+
+  cell_type c = low;
+  for ( ;; ) {
+    uint32_t cell = findCell( c );
+    if ( cell != cellCount_ ) {
+      nodes.insert( 
+        nodes.end(), cellNodes_ + cellOffsets_[cell], cellNodes_ + cellOffsets_[cell + 1] 
+      );
+    }
+    int i = 0;
+    while ( i < N && c[i] == high[i] ) {
+      c[i] = low[i];
+      ++i;
+    }
+    if ( i == N ) {
+      break;
+    }
+    ++c[i];
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+template < typename BATCH, typename KERNEL >
+void
+CompiledGHMM<T, N, FULL_N, GHMM_TRAITS>::gaussians(
+  const BATCH & whitened, 
+  const KERNEL & kernel, 
+  uint32_t n, 
+  typename Eigen::Array< value_type, Eigen::Dynamic, 1 > & result 
+)
+{
+  result.setZero( whitened.rows() );
+  for ( int d = 0; d < whitened.cols(); ++d ) {
+    result += ( whitened.col( d ).array() - kernel.centroids( d )[n] ).square();
+  }
+  result = ( - 0.5 * result ).exp();
+}
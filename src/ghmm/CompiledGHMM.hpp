@@ -0,0 +1,280 @@
+#ifndef GHMM_COMPILED_GHMM_HPP_
+#define GHMM_COMPILED_GHMM_HPP_
+
+
+#include "ghmm_default_traits.hpp"
+#include "GaussianKernel.hpp"
+#include "ModelImage.hpp"
+#include "TrackState.hpp"
+#include <eigen3/Eigen/Cholesky>
+#include <boost/graph/graph_traits.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Immutable snapshot of a learned GHMM for inference. The transition graph is
+// stored as compressed sparse rows of in-edges, and the projected centroids as
+// one contiguous array per dimension, so that filtering walks flat arrays
+// instead of the adjacency list. All arrays live in a ModelImage, which is
+// shared by copies and can be mapped directly from a model file.
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS = GHMMDefaultTraits< T, N, FULL_N > >
+class CompiledGHMM
+{
+public:
+  typedef GHMM_TRAITS traits_type;
+  typedef typename GHMM_TRAITS::full_observation_type full_observation_type;
+  typedef typename GHMM_TRAITS::observation_type observation_type;
+  typedef typename GHMM_TRAITS::goal_type goal_type;
+  typedef typename GHMM_TRAITS::value_type value_type;
+  typedef typename GHMM_TRAITS::graph_type graph_type;
+  typedef typename GHMM_TRAITS::observation_matrix_type observation_matrix_type;
+  typedef typename GHMM_TRAITS::goal_matrix_type goal_matrix_type;
+  typedef typename GHMM_TRAITS::full_matrix_type full_matrix_type;
+  typedef typename GHMM_TRAITS::numerics_type numerics_type;
+  typedef GaussianKernel< 
+      value_type, observation_matrix_type, observation_type 
+    > observation_kernel_type;
+  typedef GaussianKernel< 
+      value_type, goal_matrix_type, goal_type 
+    > goal_kernel_type;
+  typedef typename std::vector< value_type > value_array;
+  typedef typename std::vector< uint32_t > index_array;
+  typedef TrackState< value_type > track_type;
+  // Batches of tracks: one column per track, one row per node
+  typedef typename Eigen::Matrix< 
+      value_type, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor 
+    > belief_matrix_type;
+  // Batches of points: one row per track or query
+  typedef typename Eigen::Matrix< 
+      value_type, Eigen::Dynamic, N 
+    > observation_batch_type;
+  typedef typename Eigen::Matrix< 
+      value_type, Eigen::Dynamic, FULL_N - N 
+    > goal_batch_type;
+  // Densities of a batch: one row per query, one column per horizon
+  typedef typename Eigen::Matrix< 
+      value_type, Eigen::Dynamic, Eigen::Dynamic 
+    > density_matrix_type;
+
+  // Learning state stored along the model, see GHMM::save
+  struct learning_type {
+    full_matrix_type fullSigma;
+    value_type insertionDistance;
+    value_type epsilon;
+    value_type statePrior;
+    value_type transitionPrior;
+    uint32_t trajectoryCount;
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  CompiledGHMM( 
+    const graph_type & graph, 
+    const observation_matrix_type & observationSigma, 
+    const goal_matrix_type & goalSigma 
+  );
+
+  // Uses the arrays of the image in place. Throws std::runtime_error when
+  // the image was written for other types or dimensions, or when its
+  // offsets or node indices point outside the arrays.
+  explicit CompiledGHMM( const ModelImage & image );
+
+  static CompiledGHMM load( const std::string & path );
+  void save( const std::string & path ) const;
+
+  static ModelImage build( 
+    const graph_type & graph, 
+    const observation_matrix_type & observationSigma, 
+    const goal_matrix_type & goalSigma,
+    const learning_type * learning = 0
+  );
+
+  const ModelImage & image() const;
+
+  void initTrack( track_type & track ) const;
+  void update( track_type & track, const observation_type & o ) const;
+  // Only nodes within the squared Mahalanobis distance gate of the
+  // observation are updated exactly, all others are approximated by the
+  // floor value. Returns a bound of the posterior mass that approximation
+  // drops.
+  value_type update( 
+    track_type & track, 
+    const observation_type & o, 
+    value_type gate 
+  ) const;
+  void predict( track_type & track, uint8_t horizon ) const;
+  // Only nodes whose estimation is above the threshold are propagated.
+  // Returns the mass that was not propagated up to the horizon.
+  value_type predict( 
+    track_type & track, 
+    uint8_t horizon, 
+    value_type threshold 
+  ) const;
+  value_type observationPdf( 
+    const track_type & track, 
+    uint32_t t, 
+    const observation_type & o 
+  ) const;
+
+  value_type goalPdf( 
+    const track_type & track, 
+    const goal_type & g 
+  ) const;
+
+  // Batched densities. Every node is evaluated once for the whole batch of
+  // queries and its Gaussian is shared by all the requested horizons.
+  void observationPdf( 
+    const track_type & track, 
+    const index_array & horizons, 
+    const observation_batch_type & o, 
+    density_matrix_type & result 
+  ) const;
+
+  void goalPdf( 
+    const track_type & track, 
+    const goal_batch_type & g, 
+    density_matrix_type & result 
+  ) const;
+
+  // Posterior of every goal of a batch, such as the cells of a grid over
+  // the goal space, with a uniform prior over the batch
+  void goalPosterior( 
+    const track_type & track, 
+    const goal_batch_type & g, 
+    density_matrix_type & result 
+  ) const;
+
+  // The k goals of a batch with the highest posterior, best first, as rows
+  // of the batch. Fewer when the batch is smaller.
+  void topGoals( 
+    const track_type & track, 
+    const goal_batch_type & g, 
+    uint32_t k, 
+    index_array & goals, 
+    value_array & posteriors 
+  ) const;
+
+  // Likelihood of the observation at every node, floor included, and its
+  // logarithm without the floor, into nodeCount values
+  void observationLikelihoods( 
+    const observation_type & o, 
+    value_type * result 
+  ) const;
+  void observationLogLikelihoods( 
+    const observation_type & o, 
+    value_type * result 
+  ) const;
+
+  // Batched kernels, see TrackerPool
+  void initTracks( belief_matrix_type & beliefs, uint32_t first ) const;
+  void transition( 
+    const belief_matrix_type & from, 
+    belief_matrix_type & to 
+  ) const;
+  void observationProbabilities( 
+    const observation_batch_type & o, 
+    belief_matrix_type & result 
+  ) const;
+
+  uint32_t nodeCount() const;
+  uint32_t edgeCount() const;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+private:
+  enum { goal_dimension = FULL_N - N };
+
+  // Observation centroids are bucketed in a grid of one standard deviation
+  // over whitened coordinates, so that gated updates only visit nearby nodes.
+  // Occupied cells are sorted lexicographically.
+  typedef Eigen::Matrix<int32_t, 1, N> cell_type;
+
+  ModelImage       image_;
+  uint32_t         nodeCount_;
+  uint32_t         edgeCount_;
+  uint32_t         cellCount_;
+  const uint32_t   * offsets_;
+  const uint32_t   * sources_;
+  const value_type * transitions_;
+  // The same transitions as compressed rows of out-edges
+  const uint32_t   * outOffsets_;
+  const uint32_t   * targets_;
+  const value_type * outTransitions_;
+  const value_type * prior_;
+  const value_type * observationCentroids_;
+  const value_type * goalCentroids_;
+  const int32_t    * cells_;
+  const uint32_t   * cellOffsets_;
+  const uint32_t   * cellNodes_;
+  // Whitened copies of the centroids
+  observation_kernel_type observationKernel_;
+  goal_kernel_type        goalKernel_;
+
+  void bind();
+  // Throw unless count ranges of offsets rise from 0 to last, or indices
+  // are all below bound
+  static void checkOffsets( const uint32_t * offsets, uint32_t count, uint32_t last );
+  static void checkIndices( const uint32_t * indices, uint32_t count, uint32_t bound );
+
+  static cell_type cellOf( 
+    const observation_matrix_type & whitening, 
+    const observation_type & o 
+  );
+  uint32_t findCell( const cell_type & c ) const;
+  static bool cellLess( const int32_t * a, const int32_t * b );
+
+  // Orders nodes by cell, then by index
+  struct cell_order {
+    cell_order( const int32_t * cells ) : cells( cells ) {}
+    bool operator()( uint32_t a, uint32_t b ) const
+    {
+      if ( cellLess( cells + N * a, cells + N * b ) ) {
+        return true;
+      }
+      return ! cellLess( cells + N * b, cells + N * a ) && a < b;
+    }
+    const int32_t * cells;
+  };
+
+  void gateCandidates( 
+    const observation_type & o, 
+    value_type gate, 
+    index_array & nodes 
+  ) const;
+
+  // Orders rows of a batch by density, highest first, then by row
+  struct density_order {
+    density_order( const density_matrix_type & d ) : densities( d ) {}
+    bool operator()( uint32_t a, uint32_t b ) const
+    {
+      if ( densities( a, 0 ) != densities( b, 0 ) ) {
+        return densities( a, 0 ) > densities( b, 0 );
+      }
+      return a < b;
+    }
+    const density_matrix_type & densities;
+  };
+
+  // Gaussians of a batch of points, whitened already, around centroid n of
+  // a kernel. A sum of squares, one pass per dimension.
+  template < typename BATCH, typename KERNEL >
+  static void gaussians( 
+    const BATCH & whitened, 
+    const KERNEL & kernel, 
+    uint32_t n, 
+    typename Eigen::Array< value_type, Eigen::Dynamic, 1 > & result 
+  );
+};
+
+
+#include "CompiledGHMM-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_COMPILED_GHMM_HPP_
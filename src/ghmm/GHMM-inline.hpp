@@ -9,6 +9,7 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::GHMM(
   value_type transitionPrior
 ) : observationSigma_( observationSigma ),
     goalSigma_( goalSigma ),
+    fullSigma_( fullSigma ),
     statePrior_( statePrior ),
     transitionPrior_( transitionPrior ),
     graph_(),
@@ -21,205 +22,847 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::GHMM(
     observationGaussian_( observationSigma ),
     goalGaussian_( goalSigma ),
     fullGaussian_( fullSigma ),
-    trajectoryCount_( 0 )
+    fullKernel_( fullSigma ),
+    trajectoryCount_( 0 ),
+    model_( graph_, observationSigma, goalSigma ),
+    serials_(),
+    modelSerials_(),
+    movedSerials_(),
+    nextSerial_( 0 ),
+    priorSum_( 0 ),
+    priors_(),
+    movedPriors_(),
+    resets_()
 {}
 
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+GHMM<T, N, FULL_N, GHMM_TRAITS>::GHMM( const ModelImage & image )
+  : observationSigma_( 
+      image.matrix<observation_matrix_type>( ModelImage::OBSERVATION_SIGMA ) 
+    ),
+    goalSigma_( image.matrix<goal_matrix_type>( ModelImage::GOAL_SIGMA ) ),
+    fullSigma_( image.matrix<full_matrix_type>( ModelImage::FULL_SIGMA ) ),
+    statePrior_( parameters( image )[2] ),
+    transitionPrior_( parameters( image )[3] ),
+    graph_(),
+    itm_( 
+      graph_, 
+      distance_type( fullSigma_ ), 
+      parameters( image )[0], 
+      parameters( image )[1] 
+    ), 
+    observationGaussian_( observationSigma_ ),
+    goalGaussian_( goalSigma_ ),
+    fullGaussian_( fullSigma_ ),
+    fullKernel_( fullSigma_ ),
+    trajectoryCount_( image.header().trajectoryCount ),
+    model_( image ),
+    serials_(),
+    modelSerials_(),
+    movedSerials_(),
+    nextSerial_( 0 ),
+    priorSum_( 0 ),
+    priors_(),
+    movedPriors_(),
+    resets_()
+{
+  restore( image );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::save( const std::string & path ) const
+{
+  typename compiled_type::learning_type learning;
+  learning.fullSigma = fullSigma_;
+  learning.insertionDistance = itm_.insertionDistance();
+  learning.epsilon = itm_.epsilon();
+  learning.statePrior = statePrior_;
+  learning.transitionPrior = transitionPrior_;
+  learning.trajectoryCount = trajectoryCount_;
+  compiled_type::build( graph_, observationSigma_, goalSigma_, &learning ).save( path );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+const typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type *
+GHMM<T, N, FULL_N, GHMM_TRAITS>::parameters( const ModelImage & image )
+{
+  if ( image.count( ModelImage::PARAMETERS ) != 4 ) {
+    throw std::runtime_error( "Model file has no learning state" );
+  }
+  return image.section<value_type>( ModelImage::PARAMETERS );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::restore( const ModelImage & image )
+{
+  uint32_t nodeCount = model_.nodeCount();
+  if (    image.count( ModelImage::PROBABILITY_SUMS ) != nodeCount
+       || image.count( ModelImage::NUMERATOR_SUMS ) != model_.edgeCount()
+       || image.count( ModelImage::DENOMINATOR_SUMS ) != model_.edgeCount()
+  ) {
+    throw std::runtime_error( "Model file has no learning state" );
+  }
+
+  const value_type * centroids = image.section<value_type>( ModelImage::CENTROIDS );
+  const value_type * prior = image.section<value_type>( ModelImage::PRIOR );
+  const value_type * probabilitySums = 
+    image.section<value_type>( ModelImage::PROBABILITY_SUMS );
+  const uint32_t * offsets = image.section<uint32_t>( ModelImage::OUT_OFFSETS );
+  const uint32_t * targets = image.section<uint32_t>( ModelImage::TARGETS );
+  const value_type * transitions = 
+    image.section<value_type>( ModelImage::OUT_TRANSITIONS );
+  const value_type * numeratorSums = 
+    image.section<value_type>( ModelImage::NUMERATOR_SUMS );
+  const value_type * denominatorSums = 
+    image.section<value_type>( ModelImage::DENOMINATOR_SUMS );
+
+  for ( uint32_t i = 0; i < nodeCount; ++i ) {
+    node_type n = boost::add_vertex( graph_ );
+    for ( int d = 0; d < FULL_N; ++d ) {
+      graph_[n].centroid[d] = centroids[d * nodeCount + i];
+    }
+    graph_[n].probability = prior[i];
+    graph_[n].probabilitySum = probabilitySums[i];
+    priors_.push_back( probabilitySums[i] );
+    priorSum_ += probabilitySums[i];
+  }
+  for ( uint32_t i = 0; i < nodeCount; ++i ) {
+    for ( uint32_t e = offsets[i]; e < offsets[i + 1]; ++e ) {
+      if ( targets[e] >= nodeCount ) {
+        throw std::runtime_error( "Model file has an invalid edge" );
+      }
+      typename graph_type::edge_descriptor edge = 
+        boost::add_edge( boost::vertex( i, graph_ ), boost::vertex( targets[e], graph_ ), graph_ ).first;
+      graph_[edge].probability = transitions[e];
+      graph_[edge].numeratorSum = numeratorSums[e];
+      graph_[edge].denominatorSum = denominatorSums[e];
+    }
+  }
+  itm_.reindex();
+
+  for ( uint32_t i = 0; i < nodeCount; ++i ) {
+    serials_.push_back( nextSerial_++ );
+  }
+  modelSerials_ = serials_;
+}
+
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
 template< typename IT >
 void
-GHMM<T, N, FULL_N, GHMM_TRAITS>::learn( IT begin, IT end )
+GHMM<T, N, FULL_N, GHMM_TRAITS>::learn( IT begin, IT end, bool checkpointed )
 {
+  trace_type & trace = itm_.trace();
+
   trajectoryCount_++;
+  trace.start( LEARN_ITM );
   for ( IT o = begin; o != end; ++o ) {
     itm_( *o );
   }
+  compact();
+  trace.stop( LEARN_ITM );
+
+  trace.start( LEARN_NORMALIZE );
   normalize();
+  flatten();
+  trace.stop( LEARN_NORMALIZE );
 
-  computeForward( begin, end );
-  computeBackwards( std::reverse_iterator<IT>( end ), std::reverse_iterator<IT>( begin ) );
-  updateParameters( begin, end );
+  trace.start( LEARN_EXPECTATION );
+  workspaces_.resize( 1 );
+  expectation( begin, end, checkpointed, workspaces_[0] );
+  trace.stop( LEARN_EXPECTATION );
+
+  trace.start( LEARN_MAXIMIZATION );
+  updateParameters( 1 );
+  trace.stop( LEARN_MAXIMIZATION );
+
+  trace.start( LEARN_COMPILE );
+  recompile();
+  trace.stop( LEARN_COMPILE );
 }
 
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+template< typename IT >
 void
-GHMM<T, N, FULL_N, GHMM_TRAITS>::normalize()
+GHMM<T, N, FULL_N, GHMM_TRAITS>::learnBatch( 
+  IT begin, 
+  IT end, 
+  uint32_t threads, 
+  bool checkpointed 
+)
 {
-  value_type priorSum = 0;
+  trace_type & trace = itm_.trace();
 
-  typename itm_type::node_iterator n;
-  typename itm_type::node_iterator nodeEnd;
+  std::vector< IT > trajectories;
+  trace.start( LEARN_ITM );
+  for ( IT trajectory = begin; trajectory != end; ++trajectory ) {
+    trajectories.push_back( trajectory );
+    for ( typename std::iterator_traits< IT >::value_type::const_iterator o = trajectory->begin(); 
+          o != trajectory->end(); ++o 
+    ) {
+      itm_( *o );
+    }
+  }
+  compact();
+  trace.stop( LEARN_ITM );
+  if ( trajectories.empty() ) {
+    return;
+  }
+  trajectoryCount_ += trajectories.size();
 
-  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
-        n != nodeEnd; ++n
+  trace.start( LEARN_NORMALIZE );
+  normalize();
+  flatten();
+  trace.stop( LEARN_NORMALIZE );
+
+  if ( threads == 0 ) {
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#else
+    threads = 1;
+#endif
+  }
+  int32_t partitions = std::min< size_t >( threads, trajectories.size() );
+  workspaces_.resize( partitions );
+
+  trace.start( LEARN_EXPECTATION );
+#ifdef _OPENMP
+#pragma omp parallel for schedule( dynamic, 1 ) num_threads( threads )
+#endif
+  for ( int32_t p = 0; p < partitions; ++p ) {
+    uint32_t first = p * trajectories.size() / partitions;
+    uint32_t last = ( p + 1 ) * trajectories.size() / partitions;
+    for ( uint32_t i = first; i < last; ++i ) {
+      expectation( 
+        trajectories[i]->begin(), 
+        trajectories[i]->end(), 
+        checkpointed, 
+        workspaces_[p] 
+      );
+    }
+  }
+  trace.stop( LEARN_EXPECTATION );
+
+  trace.start( LEARN_MAXIMIZATION );
+  updateParameters( partitions );
+  trace.stop( LEARN_MAXIMIZATION );
+
+  trace.start( LEARN_COMPILE );
+  recompile();
+  trace.stop( LEARN_COMPILE );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+bool
+GHMM<T, N, FULL_N, GHMM_TRAITS>::compact()
+{
+  // Streamed statistics are stored by position in the flat copy of the
+  // topology, they go to the sums before the ITM changes are flattened
+  const std::vector< node_type > & moved = itm_.compact();
+  bool added = itm_.reshaped() && ! streamed_.probabilitySums.empty();
+  if ( added ) {
+    addStatistics( streamed_, moved );
+  }
+  follow( moved );
+  return added;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::follow( const std::vector< node_type > & moved )
+{
+  // Nothing follows when every node stayed and none was added
+  uint32_t stayed = 0;
+  while (    stayed < moved.size() 
+          && moved[stayed] != boost::graph_traits<graph_type>::null_vertex()
+          && boost::get( boost::vertex_index, graph_, moved[stayed] ) == stayed 
   ) {
-    // Add self-edges
-    boost::add_edge( *n, *n, graph_ );
-    if ( graph_[*n].probability <= statePrior_ ) {
-      graph_[*n].probabilitySum   = statePrior_;
+    ++stayed;
+  }
+  if ( stayed == boost::num_vertices( graph_ ) ) {
+    return;
+  }
+
+  // Open sessions follow their nodes to their new indices
+  for ( uint32_t i = 0; i < sessions_.size(); ++i ) {
+    if ( sessions_[i].open ) {
+      remap( sessions_[i], moved );
+    }
+  }
+
+  // Serials follow their nodes, new nodes get the next ones
+  const uint64_t unset = uint64_t( -1 );
+  movedSerials_.assign( boost::num_vertices( graph_ ), unset );
+  for ( uint32_t i = 0; i < moved.size(); ++i ) {
+    if ( moved[i] != boost::graph_traits<graph_type>::null_vertex() ) {
+      movedSerials_[boost::get( boost::vertex_index, graph_, moved[i] )] = serials_[i];
+    }
+  }
+  for ( uint32_t n = 0; n < movedSerials_.size(); ++n ) {
+    if ( movedSerials_[n] == unset ) {
+      movedSerials_[n] = nextSerial_++;
+    }
+  }
+  serials_.swap( movedSerials_ );
+
+  // Removed nodes leave the prior sum, nodes to reset follow theirs
+  assert( priors_.size() == moved.size() );
+  movedPriors_.assign( boost::num_vertices( graph_ ), 0 );
+  for ( uint32_t i = 0; i < moved.size(); ++i ) {
+    if ( moved[i] != boost::graph_traits<graph_type>::null_vertex() ) {
+      movedPriors_[boost::get( boost::vertex_index, graph_, moved[i] )] = priors_[i];
+    } else {
+      priorSum_ -= priors_[i];
+    }
+  }
+  priors_.swap( movedPriors_ );
+  uint32_t reset = 0;
+  for ( uint32_t i = 0; i < resets_.size(); ++i ) {
+    if ( moved[resets_[i]] != boost::graph_traits<graph_type>::null_vertex() ) {
+      resets_[reset++] = moved[resets_[i]];
     }
-    priorSum += graph_[*n].probabilitySum;
+  }
+  resets_.resize( reset );
+}
 
-    value_type transitionSum = 0;
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::reorder()
+{
+  typedef boost::adjacency_list< 
+      boost::vecS, 
+      boost::vecS, 
+      boost::undirectedS, 
+      boost::property< boost::vertex_color_t, boost::default_color_type > 
+    > topology_type;
 
-    typename itm_type::out_edge_iterator child;
-    typename itm_type::out_edge_iterator childEnd;
+  compact();
 
-    for ( boost::tie( child, childEnd ) = boost::out_edges( *n, graph_ ); 
-          child != childEnd; ++child
+  // Transitions both ways are a single undirected edge, self-transitions
+  // do not matter
+  uint32_t nodeCount = boost::num_vertices( graph_ );
+  topology_type topology( nodeCount );
+  typename boost::graph_traits< graph_type >::edge_iterator e;
+  typename boost::graph_traits< graph_type >::edge_iterator edgeEnd;
+  for ( boost::tie( e, edgeEnd ) = boost::edges( graph_ ); e != edgeEnd; ++e ) {
+    node_type source = boost::source( *e, graph_ );
+    node_type target = boost::target( *e, graph_ );
+    if (    source < target 
+         || ( source > target && ! boost::edge( target, source, graph_ ).second ) 
     ) {
-      if ( graph_[*child].numeratorSum < transitionPrior_ || graph_[*child].denominatorSum < transitionPrior_ ) {
-        graph_[*child].numeratorSum = transitionPrior_;
-        graph_[*child].denominatorSum = transitionPrior_;
-      }
-      graph_[*child].probability = graph_[*child].numeratorSum / graph_[*child].denominatorSum;
-      transitionSum += graph_[*child].probability;
+      boost::add_edge( source, target, topology );
     }
+  }
 
-    for ( boost::tie( child, childEnd ) = boost::out_edges( *n, graph_ );
-          child != childEnd; ++child
-    ) {
-      graph_[*child].probability = graph_[*child].probability / transitionSum;
+  std::vector< node_type > order( nodeCount );
+  boost::cuthill_mckee_ordering( 
+    topology, 
+    order.rbegin(), 
+    boost::get( boost::vertex_color, topology ), 
+    boost::make_degree_map( topology ) 
+  );
+  reorder( order );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::reorder( const std::vector< node_type > & order )
+{
+  compact();
+  if ( ! streamed_.probabilitySums.empty() ) {
+    addStatistics( streamed_ );
+    reestimate();
+  }
+  follow( itm_.reorder( order ) );
+  flatten();
+  recompile();
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::recompile()
+{
+  model_ = compile();
+  modelSerials_ = serials_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::normalize()
+{
+  // Nodes the ITM left alone are as the last update left them, but for the
+  // state prior of the ones flatten found below it. The prior sum follows
+  // the changes, priors are divided by it in flatten.
+  const std::vector< node_type > & dirty = itm_.dirty();
+  for ( uint32_t i = 0; i < dirty.size(); ++i ) {
+    normalize( dirty[i] );
+  }
+  for ( uint32_t i = 0; i < resets_.size(); ++i ) {
+    normalize( resets_[i] );
+  }
+  itm_.clean();
+  resets_.clear();
+  itm_.trace().size( boost::num_vertices( graph_ ), boost::num_edges( graph_ ) );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::normalize( node_type n )
+{
+  // Add self-edges, looking first as add_edge allocates even when the
+  // edge is there already
+  if ( ! boost::edge( n, n, graph_ ).second ) {
+    boost::add_edge( n, n, graph_ );
+    itm_.trace().count( EDGES_ADDED );
+  }
+  if ( graph_[n].probability <= statePrior_ ) {
+    uint32_t i = boost::get( boost::vertex_index, graph_, n );
+    priorSum_ += statePrior_ - priors_[i];
+    priors_[i] = statePrior_;
+    graph_[n].probabilitySum = statePrior_;
+  }
+
+  value_type transitionSum = 0;
+
+  typename itm_type::out_edge_iterator child;
+  typename itm_type::out_edge_iterator childEnd;
+
+  for ( boost::tie( child, childEnd ) = boost::out_edges( n, graph_ ); 
+        child != childEnd; ++child
+  ) {
+    if ( graph_[*child].numeratorSum < transitionPrior_ || graph_[*child].denominatorSum < transitionPrior_ ) {
+      graph_[*child].numeratorSum = transitionPrior_;
+      graph_[*child].denominatorSum = transitionPrior_;
     }
+    graph_[*child].probability = graph_[*child].numeratorSum / graph_[*child].denominatorSum;
+    transitionSum += graph_[*child].probability;
   }
 
-  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
-        n != nodeEnd; ++n
+  for ( boost::tie( child, childEnd ) = boost::out_edges( n, graph_ );
+        child != childEnd; ++child
   ) {
-    graph_[*n].probability = graph_[*n].probabilitySum / priorSum;
+    graph_[*child].probability = graph_[*child].probability / transitionSum;
   }
 }
 
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
-template< typename IT >
 void
-GHMM<T, N, FULL_N, GHMM_TRAITS>::computeForward( IT begin, IT end )
+GHMM<T, N, FULL_N, GHMM_TRAITS>::flatten()
 {
-  value_type total = 0;
+  uint32_t nodeCount = boost::num_vertices( graph_ );
+  uint32_t edgeCount = boost::num_edges( graph_ );
 
-  uint32_t size = std::distance( begin, end );
+  inOffsets_.clear();
+  inSources_.clear();
+  inProbabilities_.clear();
+  outOffsets_.clear();
+  outTargets_.clear();
+  outProbabilities_.clear();
+  prior_.clear();
+  resets_.clear();
 
-  factors_.resize( size );
+  inOffsets_.reserve( nodeCount + 1 );
+  inSources_.reserve( edgeCount );
+  inProbabilities_.reserve( edgeCount );
+  outOffsets_.reserve( nodeCount + 1 );
+  outTargets_.reserve( edgeCount );
+  outProbabilities_.reserve( edgeCount );
+  prior_.reserve( nodeCount );
+  fullKernel_.resize( nodeCount );
 
   typename itm_type::node_iterator n;
   typename itm_type::node_iterator nodeEnd;
+
   for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
         n != nodeEnd; ++n
   ) {
-    value_type tmp = 
-      graph_[*n].probability * observationProbability( *begin, *n );
-    if ( ! tmp > 1E-40 ) {
-      tmp = 1E-40;
+    fullKernel_.set( prior_.size(), graph_[*n].centroid );
+    typename GHMM_TRAITS::node_data_type & info = graph_[*n];
+    info.probability = info.probabilitySum / priorSum_;
+    if ( info.probability <= statePrior_ && info.probabilitySum != statePrior_ ) {
+      resets_.push_back( *n );
     }
-    graph_[*n].alpha.resize( size );
-    graph_[*n].alpha[0] = tmp;
-    total += tmp;
+    prior_.push_back( info.probability );
+
+    inOffsets_.push_back( inSources_.size() );
+
+    typename itm_type::in_edge_iterator parentEdge;
+    typename itm_type::in_edge_iterator parentEdgeEnd;
+
+    for ( boost::tie( parentEdge, parentEdgeEnd ) = boost::in_edges( *n, graph_ ); 
+          parentEdge != parentEdgeEnd; ++parentEdge
+    ) {
+      inSources_.push_back( 
+        boost::get( boost::vertex_index, graph_, boost::source( *parentEdge, graph_ ) ) 
+      );
+      inProbabilities_.push_back( graph_[*parentEdge].probability );
+    }
+
+    outOffsets_.push_back( outTargets_.size() );
+
+    typename itm_type::out_edge_iterator childEdge;
+    typename itm_type::out_edge_iterator childEdgeEnd;
+
+    for ( boost::tie( childEdge, childEdgeEnd ) = boost::out_edges( *n, graph_ ); 
+          childEdge != childEdgeEnd; ++childEdge
+    ) {
+      outTargets_.push_back( 
+        boost::get( boost::vertex_index, graph_, boost::target( *childEdge, graph_ ) ) 
+      );
+      outProbabilities_.push_back( graph_[*childEdge].probability );
+    }
+  }
+  inOffsets_.push_back( inSources_.size() );
+  outOffsets_.push_back( outTargets_.size() );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+template< typename IT >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::expectation( 
+  IT begin, 
+  IT end, 
+  bool checkpointed,
+  workspace_type & w 
+) const
+{
+  typename numerics_type::scope_type numerics;
+  uint32_t size = std::distance( begin, end );
+  uint32_t nodeCount = prior_.size();
+
+  w.probabilitySums.resize( nodeCount, 0 );
+  w.numeratorSums.resize( outTargets_.size(), 0 );
+  w.denominatorSums.resize( outTargets_.size(), 0 );
+
+  if ( size == 0 ) {
+    return;
   }
 
-  //assert( total > 0 );
+  // The trajectory is processed in segments. Alpha at the end of every 
+  // segment is kept on the way forward and beta at the start of every
+  // segment on the way backwards, so that the statistics can be gathered
+  // front to back, recomputing one segment at a time from those. A single
+  // segment keeps every step and recomputes nothing.
+  uint32_t length = size;
+  if ( checkpointed ) {
+    length = std::ceil( std::sqrt( value_type( size ) ) );
+  }
+  uint32_t segments = ( size + length - 1 ) / length;
 
-  factors_[0] = total;
-  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
-        n != nodeEnd; ++n
-  ) {
-    graph_[*n].alpha[0] /= total;
-    //assert( graph_[*n].alpha[0] > 0 );
+  std::vector< IT > starts( segments );
+  w.factors.resize( size );
+  w.alphaCheckpoints.resize( segments * nodeCount );
+  w.betaCheckpoints.resize( ( segments + 1 ) * nodeCount );
+  w.numerators.assign( outTargets_.size(), 0 );
+  w.denominators.assign( outTargets_.size(), 0 );
+
+  IT o = begin;
+  for ( uint32_t s = 0; s < segments; ++s ) {
+    uint32_t first = s * length;
+    uint32_t count = std::min( length, size - first );
+    starts[s] = o;
+    o = computeEmissions( o, count, w );
+    computeForward( first, count, s == 0 ? 0 : &w.alphaCheckpoints[( s - 1 ) * nodeCount], w );
+    std::copy( 
+      w.alpha.begin() + ( count - 1 ) * nodeCount, 
+      w.alpha.begin() + count * nodeCount,
+      w.alphaCheckpoints.begin() + s * nodeCount
+    );
   }
 
-  IT o = ++begin;
-  for (uint32_t t = 1; o != end; ++o, ++t ) {
-    total = 0;
-    for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
-          n != nodeEnd; ++n
-    ) {
-      typename GHMM_TRAITS::node_data_type & n1Info = graph_[*n]; 
-      n1Info.alpha[t] = 0;
+  std::fill( w.betaCheckpoints.begin() + segments * nodeCount, w.betaCheckpoints.end(), 1 );
+  for ( uint32_t s = segments; s-- > 0; ) {
+    uint32_t first = s * length;
+    uint32_t count = std::min( length, size - first );
+    if ( segments > 1 ) {
+      computeEmissions( starts[s], count, w );
+    }
+    computeBackwards( first, count, &w.betaCheckpoints[( s + 1 ) * nodeCount], w );
+    std::copy( 
+      w.beta.begin(), 
+      w.beta.begin() + nodeCount, 
+      w.betaCheckpoints.begin() + s * nodeCount 
+    );
+  }
 
-      typename itm_type::in_edge_iterator parentEdge;
-      typename itm_type::in_edge_iterator parentEdgeEnd;
+  for ( uint32_t s = 0; s < segments; ++s ) {
+    uint32_t first = s * length;
+    uint32_t count = std::min( length, size - first );
+    if ( segments > 1 ) {
+      computeEmissions( starts[s], count, w );
+      computeForward( first, count, s == 0 ? 0 : &w.alphaCheckpoints[( s - 1 ) * nodeCount], w );
+      computeBackwards( first, count, &w.betaCheckpoints[( s + 1 ) * nodeCount], w );
+    }
+    accumulate( first, count, s == 0 ? 0 : &w.alphaCheckpoints[( s - 1 ) * nodeCount], w );
+  }
 
-      for ( boost::tie( parentEdge, parentEdgeEnd ) = boost::in_edges( *n, graph_ ); 
-            parentEdge != parentEdgeEnd; ++parentEdge
-      ) {
-        node_type parent = boost::source( *parentEdge, graph_ );
-        value_type tmp =   graph_[parent].alpha[t - 1] 
-                         * graph_[*parentEdge].probability 
-                         * observationProbability( *o, *n );
-        n1Info.alpha[t] += tmp;
-        //std::cerr << n1Info.centroid << std::endl;
-        //std::cerr << graph_[parent].centroid << std::endl;
-        //std::cerr << "graph_[parent].alpha[t - 1]:" << graph_[parent].alpha[t - 1]  << std::endl;
-        //std::cerr << "graph_[*parentEdge].probability:" << graph_[*parentEdge].probability << std::endl;
-        //std::cerr << "observationProbability( *o, *n ):" << observationProbability( *o, *n ) << std::endl;
+  for ( uint32_t e = 0; e < outTargets_.size(); ++e ) {
+    w.numeratorSums[e] += w.numerators[e];
+    w.denominatorSums[e] += w.denominators[e];
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+template< typename IT >
+IT
+GHMM<T, N, FULL_N, GHMM_TRAITS>::computeEmissions( 
+  IT begin, 
+  uint32_t count, 
+  workspace_type & w 
+) const
+{
+  // The forward, backward and update passes read every emission from here
+  // instead of evaluating the Gaussian once per edge.
+  uint32_t nodeCount = prior_.size();
+  w.emissions.resize( count * nodeCount );
+
+  for ( uint32_t t = 0; t < count; ++t, ++begin ) {
+    fullKernel_.likelihoods( 
+      *begin, 0, nodeCount, numerics_type::floor(), &w.emissions[t * nodeCount] 
+    );
+  }
+  return begin;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::computeForward( 
+  uint32_t first,
+  uint32_t count, 
+  const value_type * previous,
+  workspace_type & w 
+) const
+{
+  uint32_t nodeCount = prior_.size();
+  uint32_t t = 0;
+
+  w.alpha.resize( count * nodeCount );
+
+  if ( previous == 0 ) {
+    value_type total = 0;
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      value_type tmp = prior_[n] * w.emissions[n];
+      if ( ! tmp > numerics_type::floor() ) {
+        tmp = numerics_type::floor();
+      }
+      w.alpha[n] = tmp;
+      total += tmp;
+    }
+
+    w.factors[first] = total;
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      w.alpha[n] /= total;
+    }
+    previous = &w.alpha[0];
+    t = 1;
+  }
+
+  for ( ; t < count; ++t ) {
+    const value_type * emissions = &w.emissions[t * nodeCount];
+    value_type * alpha = &w.alpha[t * nodeCount];
+
+    value_type total = 0;
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      alpha[n] = 0;
+      for ( uint32_t e = inOffsets_[n]; e < inOffsets_[n + 1]; ++e ) {
+        alpha[n] +=   previous[inSources_[e]] 
+                    * inProbabilities_[e] 
+                    * emissions[n];
       }
-      assert( n1Info.alpha[t] == n1Info.alpha[t] );
-      if ( n1Info.alpha[t] < 1E-40 ) {
-        n1Info.alpha[t] = 1E-40;
+      assert( alpha[n] == alpha[n] );
+      if ( alpha[n] < numerics_type::floor() ) {
+        alpha[n] = numerics_type::floor();
       }
-      total += n1Info.alpha[t];
-      assert( n1Info.alpha[t] > 0 );
+      total += alpha[n];
     }
     assert( total > 0 );
-    factors_[t] = total;
+    w.factors[first + t] = total;
 
-    for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
-          n != nodeEnd; ++n
-    ) {
-      graph_[*n].alpha[t] /= total;
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      alpha[n] /= total;
+    }
+    previous = alpha;
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::computeBackwards( 
+  uint32_t first,
+  uint32_t count, 
+  const value_type * last,
+  workspace_type & w 
+) const
+{
+  uint32_t nodeCount = prior_.size();
+  uint32_t t = count;
+
+  w.beta.resize( ( count + 1 ) * nodeCount );
+  std::copy( last, last + nodeCount, w.beta.begin() + t * nodeCount );
+
+  while ( t-- > 0 ) {
+    const value_type * next = &w.beta[( t + 1 ) * nodeCount];
+    const value_type * emissions = &w.emissions[t * nodeCount];
+    value_type * beta = &w.beta[t * nodeCount];
+
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      beta[n] = 0;
+      for ( uint32_t e = outOffsets_[n]; e < outOffsets_[n + 1]; ++e ) {
+        uint32_t n2 = outTargets_[e];
+        beta[n] +=   outProbabilities_[e] 
+                   * emissions[n2] 
+                   * next[n2]
+                   / w.factors[first + t];
+      }
+      if ( ! beta[n] > numerics_type::floor() ) {
+        beta[n] = numerics_type::floor();
+      }
+    }
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::accumulate( 
+  uint32_t first,
+  uint32_t count, 
+  const value_type * previous,
+  workspace_type & w 
+) const
+{
+  // Row t of beta covers the steps after t - 1, so the occupancy of a node
+  // at t - 1 is alpha there times beta[t], and the transition into step t
+  // takes its emission and beta[t + 1]. Smoothing gathers the same.
+  uint32_t nodeCount = prior_.size();
+
+  for ( uint32_t n = 0; n < nodeCount; ++n ) {
+    if ( first == 0 ) {
+      value_type tmp = w.alpha[n] * w.beta[nodeCount + n];
+      if ( ! tmp > numerics_type::floor() ) {
+        tmp = numerics_type::floor();
+      }
+      w.probabilitySums[n] += tmp;
+    }
+
+    // Each edge adds its terms in time order, whatever the segments are
+    for ( uint32_t e = outOffsets_[n]; e < outOffsets_[n + 1]; ++e ) {
+      uint32_t n2 = outTargets_[e];
+
+      value_type & numerator   = w.numerators[e];
+      value_type & denominator = w.denominators[e];
+      for ( uint32_t t = first == 0 ? 1 : 0; t < count; ++t ) {
+        const value_type * alpha = t == 0 ? previous : &w.alpha[( t - 1 ) * nodeCount];
+        numerator +=   alpha[n] 
+                     * outProbabilities_[e]
+                     * w.emissions[t * nodeCount + n2] 
+                     * w.beta[( t + 1 ) * nodeCount + n2]
+                     / w.factors[first + t];
+        denominator += alpha[n] * w.beta[t * nodeCount + n];
+      }
     }
   }
 }
 
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
-template< typename IT >
 void
-GHMM<T, N, FULL_N, GHMM_TRAITS>::computeBackwards( IT begin, IT end ) 
+GHMM<T, N, FULL_N, GHMM_TRAITS>::updateParameters( uint32_t workspaces )
 {
-  uint32_t t = std::distance( begin, end );
+  // Statistics are reduced in workspace order so that the result does not
+  // depend on scheduling
+  for ( uint32_t i = 1; i < workspaces; ++i ) {
+    for ( uint32_t n = 0; n < prior_.size(); ++n ) {
+      workspaces_[0].probabilitySums[n] += workspaces_[i].probabilitySums[n];
+    }
+    for ( uint32_t e = 0; e < outTargets_.size(); ++e ) {
+      workspaces_[0].numeratorSums[e] += workspaces_[i].numeratorSums[e];
+      workspaces_[0].denominatorSums[e] += workspaces_[i].denominatorSums[e];
+    }
+  }
+  addStatistics( workspaces_[0] );
+  for ( uint32_t i = 1; i < workspaces; ++i ) {
+    workspaces_[i].probabilitySums.clear();
+    workspaces_[i].numeratorSums.clear();
+    workspaces_[i].denominatorSums.clear();
+  }
+  reestimate();
+}
 
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::addStatistics( workspace_type & w )
+{
   typename itm_type::node_iterator n;
   typename itm_type::node_iterator nodeEnd;
+  typename itm_type::out_edge_iterator childEdge;
+  typename itm_type::out_edge_iterator childEdgeEnd;
 
+  uint32_t e = 0;
   for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
         n != nodeEnd; ++n
   ) {
-    graph_[*n].beta.resize( t + 1 );
-    graph_[*n].beta[t] = 1;
-  }
-
-  t--;
+    uint32_t index = boost::get( boost::vertex_index, graph_, *n );
+    graph_[*n].probabilitySum += w.probabilitySums[index];
+    priors_[index] += w.probabilitySums[index];
+    priorSum_ += w.probabilitySums[index];
 
-  for ( IT o = begin; o != end; --t, ++o ) {
-    for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
-          n != nodeEnd; ++n
+    for ( boost::tie( childEdge, childEdgeEnd ) = boost::out_edges( *n, graph_ ); 
+          childEdge != childEdgeEnd; ++childEdge, ++e
     ) {
-      value_type & beta = graph_[*n].beta[t];
-      beta = 0;
+      typename GHMM_TRAITS::edge_data_type & edgeInfo = graph_[*childEdge];
+      edgeInfo.numeratorSum += w.numeratorSums[e];
+      edgeInfo.denominatorSum += w.denominatorSums[e];
+    }
+  }
+  w.probabilitySums.clear();
+  w.numeratorSums.clear();
+  w.denominatorSums.clear();
+}
 
-      typename itm_type::out_edge_iterator childEdge;
-      typename itm_type::out_edge_iterator childEdgeEnd;
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::addStatistics( 
+  workspace_type & w, 
+  const std::vector< node_type > & moved 
+)
+{
+  // Statistics of removed nodes and edges are dropped
+  node_type none = boost::graph_traits<graph_type>::null_vertex();
+  assert( moved.size() == prior_.size() );
+  for ( uint32_t i = 0; i < moved.size(); ++i ) {
+    if ( moved[i] == none ) {
+      continue;
+    }
+    graph_[moved[i]].probabilitySum += w.probabilitySums[i];
+    priors_[i] += w.probabilitySums[i];
+    priorSum_ += w.probabilitySums[i];
 
-      for ( boost::tie( childEdge, childEdgeEnd ) = boost::out_edges( *n, graph_ ); 
-            childEdge != childEdgeEnd; ++childEdge
-      ) {
-        node_type n2 = boost::target( *childEdge, graph_ );
-        beta +=   graph_[*childEdge].probability 
-                * observationProbability( *o, n2 ) 
-                * graph_[n2].beta[t + 1]
-                / factors_[t];
+    for ( uint32_t e = outOffsets_[i]; e < outOffsets_[i + 1]; ++e ) {
+      node_type target = moved[outTargets_[e]];
+      if ( target == none ) {
+        continue;
       }
-      if ( ! beta > 1E-40 ) {
-        beta = 1E-40;
+      typename graph_type::edge_descriptor edge;
+      bool found;
+      boost::tie( edge, found ) = boost::edge( moved[i], target, graph_ );
+      if ( found ) {
+        graph_[edge].numeratorSum += w.numeratorSums[e];
+        graph_[edge].denominatorSum += w.denominatorSums[e];
       }
     }
   }
+  w.probabilitySums.clear();
+  w.numeratorSums.clear();
+  w.denominatorSums.clear();
 }
 
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
-template< typename IT >
 void
-GHMM<T, N, FULL_N, GHMM_TRAITS>::updateParameters( IT begin, IT end )
+GHMM<T, N, FULL_N, GHMM_TRAITS>::reestimate()
 {
   value_type totalPrior = 0;
+  priors_.resize( boost::num_vertices( graph_ ) );
+  resets_.clear();
 
   typename itm_type::node_iterator n;
   typename itm_type::node_iterator nodeEnd;
@@ -229,51 +872,11 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::updateParameters( IT begin, IT end )
   for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
         n != nodeEnd; ++n
   ) {
-    typename GHMM_TRAITS::node_data_type & n1Info = graph_[*n]; 
-    value_type tmp = n1Info.alpha[0] * n1Info.beta[0] * factors_[0];
-    if ( ! tmp > 1E-40 ) {
-      tmp = 1E-40;
-    }
-    n1Info.probabilitySum += tmp;
-    totalPrior += n1Info.probabilitySum;
+    uint32_t index = boost::get( boost::vertex_index, graph_, *n );
+    priors_[index] = graph_[*n].probabilitySum;
+    totalPrior += graph_[*n].probabilitySum;
   }
-  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
-        n != nodeEnd; ++n
-  ) {
-    typename GHMM_TRAITS::node_data_type & n1Info = graph_[*n]; 
-    n1Info.probability /= totalPrior;
 
-    for ( boost::tie( childEdge, childEdgeEnd ) = boost::out_edges( *n, graph_ ); 
-          childEdge != childEdgeEnd; ++childEdge
-    ) {
-      node_type n2 = boost::target( *childEdge, graph_ );
-      typename GHMM_TRAITS::edge_data_type & edgeInfo = graph_[*childEdge];
-      typename GHMM_TRAITS::node_data_type & n2Info = graph_[*n]; 
-
-      value_type numerator   = 0;
-      value_type denominator = 0;
-      uint32_t t = 1;
-      for ( IT o = begin; o != end; ++o, ++t ) {
-        numerator +=   n1Info.alpha[t - 1] 
-                     * edgeInfo.probability
-                     * observationProbability( *o, n2 ) 
-                     * n2Info.beta[t];
-        denominator += n1Info.alpha[t - 1] * n1Info.beta[t - 1] * factors_[t - 1];
-        //std::cerr << "-----\n";
-        //std::cerr << n1Info.centroid << std::endl;
-        //std::cerr << n2Info.centroid << std::endl;
-        //std::cerr << "n1Info.alpha[t - 1]:" << n1Info.alpha[t - 1] << std::endl;
-        //std::cerr << "edgeInfo.probability:" << edgeInfo.probability << std::endl;
-        //std::cerr << "observationProbability( *o, n2 ):" << observationProbability( *o, n2 ) << std::endl;
-        //std::cerr << "n2Info.beta[t]:" << n2Info.beta[t] << std::endl;
-        //std::cerr << "n1Info.beta[t - 1]:" << n1Info.beta[t - 1] << std::endl;
-        //std::cerr << "factors_[t - 1]:" << factors_[t - 1] << std::endl;
-      }
-      edgeInfo.numeratorSum += numerator;
-      edgeInfo.denominatorSum += denominator;
-      //std::cerr << edgeInfo.numeratorSum << ", " << edgeInfo.denominatorSum << std::endl;
-    }
-  }
   for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ );
         n != nodeEnd; ++n
   ) {
@@ -285,10 +888,6 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::updateParameters( IT begin, IT end )
     ) {
       graph_[*childEdge].probability = graph_[*childEdge].numeratorSum / graph_[*childEdge].denominatorSum;
       tmp += graph_[*childEdge].probability;
-      if ( tmp == tmp ) {
-      } else {
-        //std::cerr << graph_[*childEdge].numeratorSum << "/" << graph_[*childEdge].denominatorSum << std::endl;
-      }
     }
 
     assert( tmp == tmp );
@@ -302,7 +901,287 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::updateParameters( IT begin, IT end )
       edgeInfo.probability = edgeInfo.probability / tmp;    
     }
     n1Info.probability = n1Info.probabilitySum / totalPrior;  
+    if ( n1Info.probability <= statePrior_ && n1Info.probabilitySum != statePrior_ ) {
+      resets_.push_back( *n );
+    }
+  }
+  priorSum_ = totalPrior;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::session_id
+GHMM<T, N, FULL_N, GHMM_TRAITS>::beginTrajectory( uint32_t lag )
+{
+  session_id session;
+  if ( freeSessions_.empty() ) {
+    session = sessions_.size();
+    sessions_.push_back( session_type() );
+  } else {
+    session = freeSessions_.back();
+    freeSessions_.pop_back();
+  }
+
+  session_type & s = sessions_[session];
+  s.open = true;
+  s.lag = lag;
+  s.first = 0;
+  s.size = 0;
+  s.observations.resize( lag + 1 );
+  s.emissions.resize( lag + 1 );
+  s.belief.clear();
+
+  trajectoryCount_++;
+  return session;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::observe( 
+  session_id session, 
+  const full_observation_type & o 
+)
+{
+  assert( session < sessions_.size() && sessions_[session].open );
+  trace_type & trace = itm_.trace();
+
+  trace.start( LEARN_ITM );
+  itm_( o );
+  // Nodes that only moved keep the flat copy, but for their centroids
+  bool reshaped = itm_.reshaped() || ! resets_.empty();
+  bool added = compact();
+  trace.stop( LEARN_ITM );
+
+  trace.start( LEARN_NORMALIZE );
+  if ( ! reshaped ) {
+    const std::vector< node_type > & dirty = itm_.dirty();
+    for ( uint32_t i = 0; i < dirty.size(); ++i ) {
+      fullKernel_.set( 
+        boost::get( boost::vertex_index, graph_, dirty[i] ), 
+        graph_[dirty[i]].centroid 
+      );
+    }
+  }
+  normalize();
+  trace.stop( LEARN_NORMALIZE );
+
+  if ( added ) {
+    trace.start( LEARN_MAXIMIZATION );
+    reestimate();
+    trace.stop( LEARN_MAXIMIZATION );
+  }
+  if ( reshaped ) {
+    trace.start( LEARN_NORMALIZE );
+    flatten();
+    trace.stop( LEARN_NORMALIZE );
+  }
+
+  session_type & s = sessions_[session];
+  uint32_t row = ( s.first + s.size ) % s.observations.size();
+  s.observations[row] = o;
+  s.emissions[row].resize( prior_.size() );
+  fullKernel_.likelihoods( 
+    o, 0, prior_.size(), numerics_type::floor(), &s.emissions[row][0] 
+  );
+
+  if ( ++s.size > s.lag ) {
+    smooth( s );
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::endTrajectory( session_id session )
+{
+  assert( session < sessions_.size() && sessions_[session].open );
+
+  // The rest of the window is smoothed over what is left of it
+  trace_type & trace = itm_.trace();
+  session_type & s = sessions_[session];
+  while ( s.size > 0 ) {
+    smooth( s );
+  }
+
+  s.open = false;
+  observation_array().swap( s.observations );
+  std::vector< value_array >().swap( s.emissions );
+  value_array().swap( s.belief );
+  freeSessions_.push_back( session );
+
+  // The topology is the flattened one, see compact
+  if ( ! streamed_.probabilitySums.empty() ) {
+    trace.start( LEARN_MAXIMIZATION );
+    addStatistics( streamed_ );
+    reestimate();
+    trace.stop( LEARN_MAXIMIZATION );
+
+    trace.start( LEARN_NORMALIZE );
+    flatten();
+    trace.stop( LEARN_NORMALIZE );
+  }
+
+  trace.start( LEARN_COMPILE );
+  recompile();
+  trace.stop( LEARN_COMPILE );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::remap( 
+  session_type & s, 
+  const std::vector< node_type > & moved 
+)
+{
+  // Values of the nodes that stayed follow them, nodes that are new get
+  // theirs computed. Emissions of the nodes that stayed are not recomputed
+  // when their centroids move.
+  node_type none = boost::graph_traits<graph_type>::null_vertex();
+  uint32_t nodeCount = boost::num_vertices( graph_ );
+  std::vector< bool > fresh( nodeCount, true );
+  for ( uint32_t i = 0; i < moved.size(); ++i ) {
+    if ( moved[i] != none ) {
+      fresh[boost::get( boost::vertex_index, graph_, moved[i] )] = false;
+    }
+  }
+
+  uint32_t capacity = s.observations.size();
+  value_array values;
+  for ( uint32_t k = 0; k <= s.size; ++k ) {
+    // The belief goes last
+    uint32_t row = ( s.first + k ) % capacity;
+    value_array & current = k < s.size ? s.emissions[row] : s.belief;
+    if ( current.empty() ) {
+      continue;
+    }
+    assert( current.size() == moved.size() );
+    values.assign( nodeCount, 0 );
+    for ( uint32_t i = 0; i < moved.size(); ++i ) {
+      if ( moved[i] != none ) {
+        values[boost::get( boost::vertex_index, graph_, moved[i] )] = current[i];
+      }
+    }
+    if ( k < s.size ) {
+      for ( uint32_t n = 0; n < nodeCount; ++n ) {
+        if ( fresh[n] ) {
+          values[n] = observationProbability( 
+            s.observations[row], boost::vertex( n, graph_ ) 
+          );
+        }
+      }
+    }
+    current.swap( values );
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::smooth( session_type & s )
+{
+  typename numerics_type::scope_type numerics;
+  // Gathers the statistics of the oldest observation of the window, with
+  // a backward pass over the window only, then moves the belief past it.
+  // With the whole trajectory in the window, these are the ones accumulate
+  // gathers.
+  trace_type & trace = itm_.trace();
+  trace.start( LEARN_EXPECTATION );
+
+  uint32_t nodeCount = prior_.size();
+  uint32_t capacity = s.observations.size();
+  if ( workspaces_.empty() ) {
+    workspaces_.resize( 1 );
+  }
+  workspace_type & w = workspaces_[0];
+
+  value_array & beta = w.beta;
+  value_array & next = w.factors;
+  beta.assign( nodeCount, 1 );
+  next.resize( nodeCount );
+  for ( uint32_t k = s.size - 1; k > 0; --k ) {
+    const value_type * emissions = &s.emissions[( s.first + k ) % capacity][0];
+    value_type total = 0;
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      next[n] = 0;
+      for ( uint32_t e = outOffsets_[n]; e < outOffsets_[n + 1]; ++e ) {
+        uint32_t n2 = outTargets_[e];
+        next[n] += outProbabilities_[e] * emissions[n2] * beta[n2];
+      }
+      total += next[n];
+    }
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      next[n] /= total;
+      if ( next[n] < numerics_type::floor() ) {
+        next[n] = numerics_type::floor();
+      }
+    }
+    std::swap( beta, next );
+  }
+
+  // Prediction of the oldest observation from the belief before it
+  const value_type * emissions = &s.emissions[s.first][0];
+  value_array & predicted = w.alpha;
+  predicted.resize( nodeCount );
+  if ( s.belief.empty() ) {
+    std::copy( prior_.begin(), prior_.end(), predicted.begin() );
+  } else {
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      predicted[n] = 0;
+      for ( uint32_t e = inOffsets_[n]; e < inOffsets_[n + 1]; ++e ) {
+        predicted[n] += s.belief[inSources_[e]] * inProbabilities_[e];
+      }
+    }
+  }
+
+  value_type total = 0;
+  for ( uint32_t n = 0; n < nodeCount; ++n ) {
+    total += predicted[n] * emissions[n] * beta[n];
+  }
+
+  // Statistics add up until compact or endTrajectory take them
+  workspace_type & statistics = streamed_;
+  if ( statistics.probabilitySums.empty() ) {
+    statistics.probabilitySums.assign( nodeCount, 0 );
+    statistics.numeratorSums.assign( outTargets_.size(), 0 );
+    statistics.denominatorSums.assign( outTargets_.size(), 0 );
+  }
+  if ( s.belief.empty() ) {
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      statistics.probabilitySums[n] += predicted[n] * emissions[n] * beta[n] / total;
+    }
+  } else {
+    for ( uint32_t n = 0; n < nodeCount; ++n ) {
+      value_type occupancy = 0;
+      for ( uint32_t e = outOffsets_[n]; e < outOffsets_[n + 1]; ++e ) {
+        uint32_t n2 = outTargets_[e];
+        value_type transition =   s.belief[n] 
+                                * outProbabilities_[e] 
+                                * emissions[n2] 
+                                * beta[n2] 
+                                / total;
+        statistics.numeratorSums[e] += transition;
+        occupancy += transition;
+      }
+      for ( uint32_t e = outOffsets_[n]; e < outOffsets_[n + 1]; ++e ) {
+        statistics.denominatorSums[e] += occupancy;
+      }
+    }
+  }
+  trace.stop( LEARN_EXPECTATION );
+
+  total = 0;
+  s.belief.resize( nodeCount );
+  for ( uint32_t n = 0; n < nodeCount; ++n ) {
+    value_type tmp = predicted[n] * emissions[n];
+    if ( tmp < numerics_type::floor() ) {
+      tmp = numerics_type::floor();
+    }
+    s.belief[n] = tmp;
+    total += tmp;
   }
+  for ( uint32_t n = 0; n < nodeCount; ++n ) {
+    s.belief[n] /= total;
+  }
+
+  s.first = ( s.first + 1 ) % capacity;
+  --s.size;
 }
 
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
@@ -312,8 +1191,7 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::observationProbability(
   const node_type & n
 ) const
 {
-  value_type result = observationGaussian_( o, GHMM_TRAITS::toObservation( graph_[n].centroid ) );
-  return result + 1E-40;
+  return observationProbability( graph_, o, n );
 }
 
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
@@ -324,17 +1202,40 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::observationProbability(
 ) const
 {
   value_type result = fullGaussian_( o, graph_[n].centroid );
-  return result + 1E-40;
+  return result + numerics_type::floor();
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
+GHMM<T, N, FULL_N, GHMM_TRAITS>::goalProbability(
+  const goal_type & g,
+  const node_type & n
+) const
+{
+  return goalProbability( graph_, g, n );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
+GHMM<T, N, FULL_N, GHMM_TRAITS>::observationProbability(
+  const graph_type & graph,
+  const observation_type & o,
+  const node_type & n
+) const
+{
+  value_type result = observationGaussian_( o, GHMM_TRAITS::toObservation( graph[n].centroid ) );
+  return result + numerics_type::floor();
 }
 
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
 typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
 GHMM<T, N, FULL_N, GHMM_TRAITS>::goalProbability(
+  const graph_type & graph,
   const goal_type & g,
   const node_type & n
 ) const
 {
-  value_type result = observationGaussian_( g, GHMM_TRAITS::toGoal( graph_[n].centroid ) );
+  value_type result = goalGaussian_( g, GHMM_TRAITS::toGoal( graph[n].centroid ) );
   return result;
 }
 
@@ -345,6 +1246,8 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::update(
   const observation_type & o
 ) const
 {
+  typename numerics_type::scope_type numerics;
+
   typename itm_type::node_iterator n;
   typename itm_type::node_iterator nodeEnd;
 
@@ -366,15 +1269,14 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::update(
       node_type parent = boost::source( *parentEdge, graph );
       assert( graph[parent].belief == graph[parent].belief );
       assert( graph[*parentEdge].probability == graph[*parentEdge].probability );
-      std::cerr << "observation: " << o << ", *n:" << graph_[*n].centroid << std::endl;
-      assert( observationProbability( o, *n ) == observationProbability( o, *n ) );
+      assert( observationProbability( graph, o, *n ) == observationProbability( graph, o, *n ) );
       value_type tmp =   graph[parent].belief 
                        * graph[*parentEdge].probability 
-                       * observationProbability( o, *n );
+                       * observationProbability( graph, o, *n );
       n1.estimations[0] += tmp;
     }
-    if ( n1.estimations[0] < 1E-40 ) {
-      n1.estimations[0] = 1E-40;
+    if ( n1.estimations[0] < numerics_type::floor() ) {
+      n1.estimations[0] = numerics_type::floor();
     }
     total += n1.estimations[0];
   }
@@ -395,6 +1297,8 @@ template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
 void
 GHMM<T, N, FULL_N, GHMM_TRAITS>::predict( graph_type & graph, uint8_t horizon ) const
 {
+  typename numerics_type::scope_type numerics;
+
   typename itm_type::node_iterator n;
   typename itm_type::node_iterator nodeEnd;
 
@@ -440,7 +1344,7 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::initTrack( graph_type & graph ) const
   ) {
     typename GHMM_TRAITS::node_data_type & n1 = graph[*n];
     n1.belief = n1.probability;
-    n1.estimations.reserve( 1 );
+    n1.estimations.resize( 1 );
     n1.estimations[0] = n1.probability;
   }
 }
@@ -453,14 +1357,14 @@ typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
   const observation_type & o 
 ) const 
 {
-  value_type result = 1E-40;
+  value_type result = numerics_type::floor();
   value_type beliefTotal = 0;
   typename itm_type::node_iterator n;
   typename itm_type::node_iterator nodeEnd;
   for ( boost::tie( n, nodeEnd ) = boost::vertices( graph );
         n != nodeEnd; ++n
   ) {
-    result += graph[*n].estimations[t] * observationProbability( o, *n ) + 1E-40;
+    result += graph[*n].estimations[t] * observationProbability( graph, o, *n ) + numerics_type::floor();
     beliefTotal += graph[*n].estimations[t];
   }
   assert( result == result );
@@ -475,14 +1379,14 @@ typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
   const goal_type & g 
 ) const 
 {
-  value_type result = 1E-40;
+  value_type result = numerics_type::floor();
   value_type beliefTotal = 0;
   typename itm_type::node_iterator n;
   typename itm_type::node_iterator nodeEnd;
   for ( boost::tie( n, nodeEnd ) = boost::vertices( graph );
         n != nodeEnd; ++n
   ) {
-    result += graph[*n].estimations[0] * goalProbability( g, *n ) + 1E-40;
+    result += graph[*n].estimations[0] * goalProbability( graph, g, *n ) + numerics_type::floor();
     beliefTotal += graph[*n].estimations[0];
   }
   assert( result == result );
@@ -490,6 +1394,141 @@ typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
   return result;
 }
 
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::initTrack( track_type & track ) const
+{
+  model_.initTrack( track );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::update( 
+  track_type & track, 
+  const observation_type & o
+) const
+{
+  model_.update( track, o );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type 
+GHMM<T, N, FULL_N, GHMM_TRAITS>::update( 
+  track_type & track, 
+  const observation_type & o,
+  value_type gate
+) const
+{
+  return model_.update( track, o, gate );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::predict( track_type & track, uint8_t horizon ) const
+{
+  model_.predict( track, horizon );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type 
+GHMM<T, N, FULL_N, GHMM_TRAITS>::predict( 
+  track_type & track, 
+  uint8_t horizon, 
+  value_type threshold 
+) const
+{
+  return model_.predict( track, horizon, threshold );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type 
+GHMM<T, N, FULL_N, GHMM_TRAITS>::observationPdf(
+  const track_type & track, 
+  uint32_t t, 
+  const observation_type & o 
+) const 
+{
+  return model_.observationPdf( track, t, o );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::value_type 
+GHMM<T, N, FULL_N, GHMM_TRAITS>::goalPdf(
+  const track_type & track, 
+  const goal_type & g 
+) const 
+{
+  return model_.goalPdf( track, g );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::observationPdf(
+  const track_type & track, 
+  const typename compiled_type::index_array & horizons, 
+  const typename compiled_type::observation_batch_type & o, 
+  typename compiled_type::density_matrix_type & result 
+) const 
+{
+  model_.observationPdf( track, horizons, o, result );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::goalPdf(
+  const track_type & track, 
+  const typename compiled_type::goal_batch_type & g, 
+  typename compiled_type::density_matrix_type & result 
+) const 
+{
+  model_.goalPdf( track, g, result );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::goalPosterior(
+  const track_type & track, 
+  const typename compiled_type::goal_batch_type & g, 
+  typename compiled_type::density_matrix_type & result 
+) const 
+{
+  model_.goalPosterior( track, g, result );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+GHMM<T, N, FULL_N, GHMM_TRAITS>::topGoals(
+  const track_type & track, 
+  const typename compiled_type::goal_batch_type & g, 
+  uint32_t k, 
+  typename compiled_type::index_array & goals, 
+  typename compiled_type::value_array & posteriors 
+) const 
+{
+  model_.topGoals( track, g, k, goals, posteriors );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::compiled_type
+GHMM<T, N, FULL_N, GHMM_TRAITS>::compile() const
+{
+  return compiled_type( graph_, observationSigma_, goalSigma_ );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+const typename GHMM<T, N, FULL_N, GHMM_TRAITS>::compiled_type &
+GHMM<T, N, FULL_N, GHMM_TRAITS>::model() const
+{
+  return model_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+const std::vector< uint64_t > &
+GHMM<T, N, FULL_N, GHMM_TRAITS>::serials() const
+{
+  return modelSerials_;
+}
+
 template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
 typename GHMM<T, N, FULL_N, GHMM_TRAITS>::graph_type &
 GHMM<T, N, FULL_N, GHMM_TRAITS>::graph()
@@ -497,3 +1536,10 @@ GHMM<T, N, FULL_N, GHMM_TRAITS>::graph()
   return graph_;
 }
 
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename GHMM<T, N, FULL_N, GHMM_TRAITS>::trace_type &
+GHMM<T, N, FULL_N, GHMM_TRAITS>::trace() const
+{
+  return itm_.trace();
+}
+
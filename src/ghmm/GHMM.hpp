@@ -3,7 +3,18 @@
 
 
 #include "ghmm_default_traits.hpp"
+#include "CompiledGHMM.hpp"
 #include <boost/graph/copy.hpp>
+#include <boost/graph/cuthill_mckee_ordering.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 namespace ghmm
@@ -25,14 +36,24 @@ public:
   typedef typename GHMM_TRAITS::goal_gaussian_type goal_gaussian_type;
   typedef typename GHMM_TRAITS::full_gaussian_type full_gaussian_type;
   typedef typename GHMM_TRAITS::full_matrix_type full_matrix_type;
+  typedef typename GHMM_TRAITS::numerics_type numerics_type;
   typedef typename GHMM_TRAITS::observation_matrix_type observation_matrix_type;
   typedef typename GHMM_TRAITS::goal_matrix_type goal_matrix_type;
   typedef typename GHMM_TRAITS::itm_type itm_type;
+  typedef typename GHMM_TRAITS::trace_type trace_type;
   typedef typename GHMM_TRAITS::itm_type::node_type node_type;
   typedef typename itm_type::node_iterator node_iterator;
   typedef typename itm_type::out_edge_iterator out_edge_iterator;
   typedef typename itm_type::in_edge_iterator in_edge_iterator;
   typedef typename GHMM_TRAITS::estimations_type estimations_type;
+  typedef CompiledGHMM<T, N, FULL_N, GHMM_TRAITS> compiled_type;
+  typedef typename compiled_type::track_type track_type;
+  typedef uint32_t session_id;
+  // Observations need aligned storage to be vectorized
+  typedef typename std::vector< 
+    full_observation_type, 
+    Eigen::aligned_allocator< full_observation_type > 
+  > trajectory_type;
 
   GHMM( 
     full_matrix_type fullSigma, 
@@ -44,6 +65,12 @@ public:
     value_type transitionPrior
   );
 
+  // Restores a model written by save. Throws std::runtime_error when the
+  // image does not hold the learning state or was written for other types.
+  explicit GHMM( const ModelImage & image );
+
+  void save( const std::string & path ) const;
+
   void initTrack( graph_type & graph ) const;
   void update( graph_type & graph, const observation_type & o ) const;
   void predict( graph_type & graph, uint8_t horizon ) const;
@@ -58,12 +85,163 @@ public:
     const goal_type & g 
   ) const;
 
+  // Tracking against the model learned so far. The track only holds a
+  // belief per node and must be reinitialized after learning.
+  void initTrack( track_type & track ) const;
+  void update( track_type & track, const observation_type & o ) const;
+  // Gated update, see CompiledGHMM. Returns the dropped mass.
+  value_type update( 
+    track_type & track, 
+    const observation_type & o, 
+    value_type gate 
+  ) const;
+  void predict( track_type & track, uint8_t horizon ) const;
+  // Sparse prediction, see CompiledGHMM. Returns the pruned mass.
+  value_type predict( 
+    track_type & track, 
+    uint8_t horizon, 
+    value_type threshold 
+  ) const;
+  value_type observationPdf( 
+    const track_type & track, 
+    uint32_t t, 
+    const observation_type & o 
+  ) const;
+
+  value_type goalPdf( 
+    const track_type & track, 
+    const goal_type & g 
+  ) const;
+
+  // Batched densities, see CompiledGHMM
+  void observationPdf( 
+    const track_type & track, 
+    const typename compiled_type::index_array & horizons, 
+    const typename compiled_type::observation_batch_type & o, 
+    typename compiled_type::density_matrix_type & result 
+  ) const;
+
+  void goalPdf( 
+    const track_type & track, 
+    const typename compiled_type::goal_batch_type & g, 
+    typename compiled_type::density_matrix_type & result 
+  ) const;
+
+  // Goal posteriors and ranking over a batch, see CompiledGHMM
+  void goalPosterior( 
+    const track_type & track, 
+    const typename compiled_type::goal_batch_type & g, 
+    typename compiled_type::density_matrix_type & result 
+  ) const;
+
+  void topGoals( 
+    const track_type & track, 
+    const typename compiled_type::goal_batch_type & g, 
+    uint32_t k, 
+    typename compiled_type::index_array & goals, 
+    typename compiled_type::value_array & posteriors 
+  ) const;
+
+  // Checkpointed learning keeps alpha and beta every sqrt( T ) steps only
+  // and recomputes the steps in between, so the expectation step takes
+  // O( sqrt( T ) V ) memory instead of O( T V ), for about twice the work.
+  // The result is the same either way.
+  template < typename IT >
+  void learn( IT begin, IT end, bool checkpointed = false );
+
+  // Learns from a range of trajectories at once. The topology is grown and
+  // normalized once, then the expectation step runs on every trajectory in
+  // parallel and the statistics are reduced in a fixed order. Trajectories
+  // are split into as many contiguous partitions as threads (all available
+  // ones by default), results only depend on that number. Runs in parallel
+  // only in code built with OpenMP, as this header is compiled by its user,
+  // otherwise the partitions run one after the other.
   template < typename IT >
-  void learn( IT begin, IT end );
+  void learnBatch( 
+    IT begin, 
+    IT end, 
+    uint32_t threads = 0, 
+    bool checkpointed = false 
+  );
+
+  // Streaming learning, for trajectories that are not known in advance.
+  // Observations go to the ITM as they arrive, and the statistics of each one
+  // are gathered once lag more have been observed, smoothing over those only.
+  // A session keeps that window and a belief, so its memory does not grow
+  // with the trajectory. Statistics add up, and parameters are updated from
+  // them when a trajectory ends and before the ITM changes the topology.
+  // The flat copy of the model is rebuilt along with the topology only, so
+  // that otherwise an observation costs its emissions and the pass over the
+  // window. The model used for tracking is compiled when a trajectory ends.
+  // Any number of sessions may be open at once.
+  session_id beginTrajectory( uint32_t lag );
+  void observe( session_id session, const full_observation_type & o );
+  void endTrajectory( session_id session );
+
+  // Stores the nodes in reverse Cuthill-McKee order of the topology, so that
+  // the nodes a transition joins are close in the compiled model, or in the
+  // order given, which holds every node once. model() is recompiled and
+  // serials follow their nodes, see ModelHandle, but tracks must be
+  // reinitialized otherwise. Open sessions follow their nodes too.
+  void reorder();
+  void reorder( const std::vector< node_type > & order );
+
+  compiled_type compile() const;
+  // The model tracking uses, compiled when learning last finished
+  const compiled_type & model() const;
+  // Serial number of every node of model(). Nodes keep their serial while
+  // learning renumbers them, so that beliefs can follow them from one model
+  // to a later one, see ModelHandle.
+  const std::vector< uint64_t > & serials() const;
 
   graph_type & graph();
+
+  // Changes to the graph and the phases of learning, see Trace.hpp. Nothing
+  // is recorded with the default NullTrace. Learning must not run alongside
+  // anything else, tracking is const and may run from any number of threads
+  // at once, so it records nothing here.
+  trace_type & trace() const;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 private:
   typedef typename std::vector< value_type > value_array;
+  typedef typename std::vector< uint32_t > index_array;
+  typedef GaussianKernel< 
+      value_type, full_matrix_type, full_observation_type 
+    > full_kernel_type;
+
+  // Buffers and accumulated statistics of the expectation step, so that
+  // trajectories can be processed concurrently. Alpha, beta and emissions
+  // have one row per time step of a segment and one column per node, the
+  // checkpoints one row per segment.
+  struct workspace_type {
+    value_array emissions;
+    value_array alpha;
+    value_array beta;
+    value_array factors;
+    value_array alphaCheckpoints;
+    value_array betaCheckpoints;
+    value_array numerators;
+    value_array denominators;
+    value_array probabilitySums;
+    value_array numeratorSums;
+    value_array denominatorSums;
+  };
+
+  typedef trajectory_type observation_array;
+
+  // State of a streaming trajectory. Observations and their emissions are
+  // rings of lag + 1 rows, the belief is the filtered one just before the
+  // oldest row, empty until the first statistic is gathered.
+  struct session_type {
+    session_type() : open( false ), lag( 0 ), first( 0 ), size( 0 ) {}
+    bool open;
+    uint32_t lag;
+    uint32_t first;
+    uint32_t size;
+    observation_array observations;
+    std::vector< value_array > emissions;
+    value_array belief;
+  };
 
   observation_matrix_type   observationSigma_;
   goal_matrix_type          goalSigma_;
@@ -75,20 +253,97 @@ private:
   observation_gaussian_type observationGaussian_;
   goal_gaussian_type        goalGaussian_;
   full_gaussian_type        fullGaussian_;
+  // Centroids of the graph as of the last flatten, for the emissions
+  full_kernel_type          fullKernel_;
   uint32_t                  trajectoryCount_;
+  compiled_type             model_;
+  // Serials of the nodes of the graph and of model_, by index
+  std::vector< uint64_t >   serials_;
+  std::vector< uint64_t >   modelSerials_;
+  std::vector< uint64_t >   movedSerials_;
+  uint64_t                  nextSerial_;
+  // Sum of the probability sums of the nodes, and every sum as counted in
+  // it, by index, so that removed nodes can be taken out
+  value_type                priorSum_;
+  value_array               priors_;
+  value_array               movedPriors_;
+  // Nodes whose prior is at most the state prior, for normalize to reset
+  std::vector< node_type >  resets_;
+
+  // Flat copy of the topology taken after normalization. In-edges keep the
+  // order of the graph, out-edges are numbered in out-edge order, which is
+  // the order edge statistics are stored in.
+  index_array inOffsets_;
+  index_array inSources_;
+  value_array inProbabilities_;
+  index_array outOffsets_;
+  index_array outTargets_;
+  value_array outProbabilities_;
+  value_array prior_;
+  std::vector< workspace_type > workspaces_;
+  // Statistics streaming sessions gathered since the parameters were last
+  // updated, empty when there are none
+  workspace_type streamed_;
+  std::vector< session_type > sessions_;
+  index_array freeSessions_;
 
-  value_array factors_;
+  static const value_type * parameters( const ModelImage & image );
+  void restore( const ModelImage & image );
 
+  // Returns whether streamed statistics were added to the sums, which
+  // then need reestimate
+  bool compact();
+  // Moves sessions and serials along with the nodes, see ITM::compact
+  void follow( const std::vector< node_type > & moved );
+  void recompile();
+  // Normalizes the nodes the ITM changed only, see ITM::dirty
   void normalize();
+  void normalize( node_type n );
+  void flatten();
 
   template < typename IT >
-  void computeForward( IT begin, IT end );
+  void expectation( 
+    IT begin, 
+    IT end, 
+    bool checkpointed, 
+    workspace_type & w 
+  ) const;
 
+  // Segment functions, first is the time step the segment starts at
   template < typename IT >
-  void computeBackwards( IT begin, IT end );
+  IT computeEmissions( IT begin, uint32_t count, workspace_type & w ) const;
 
-  template < typename IT >
-  void updateParameters( IT begin, IT end );
+  void computeForward( 
+    uint32_t first, 
+    uint32_t count, 
+    const value_type * previous, 
+    workspace_type & w 
+  ) const;
+
+  void computeBackwards( 
+    uint32_t first, 
+    uint32_t count, 
+    const value_type * last, 
+    workspace_type & w 
+  ) const;
+
+  // Previous is the alpha just before the segment, null for the first one
+  void accumulate( 
+    uint32_t first, 
+    uint32_t count, 
+    const value_type * previous, 
+    workspace_type & w 
+  ) const;
+  void updateParameters( uint32_t workspaces );
+  // Adds statistics to the sums, stored by position in the flat copy of the
+  // topology. With moved, the graph changed since, see ITM::compact.
+  void addStatistics( workspace_type & w );
+  void addStatistics( workspace_type & w, const std::vector< node_type > & moved );
+  // Probabilities of every node and edge from the sums
+  void reestimate();
+
+  void remap( session_type & s, const std::vector< node_type > & moved );
+  void smooth( session_type & s );
 
   value_type observationProbability( 
     const observation_type & o, 
@@ -104,6 +359,19 @@ private:
     const goal_type & g, 
     const node_type & n 
   ) const;
+
+  // The same against a copy of the graph, see initTrack
+  value_type observationProbability( 
+    const graph_type & graph, 
+    const observation_type & o, 
+    const node_type & n 
+  ) const;
+
+  value_type goalProbability( 
+    const graph_type & graph, 
+    const goal_type & g, 
+    const node_type & n 
+  ) const;
 };
 
 
@@ -0,0 +1,123 @@
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::GaussianKernel( matrix_type sigma )
+  : whitening_( Eigen::LLT<matrix_type>( sigma.inverse() ).matrixL() ),
+    count_( 0 ),
+    centroids_()
+{}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+uint32_t
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::size() const
+{
+  return count_;
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+void
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::resize( uint32_t count )
+{
+  count_ = count;
+  centroids_.resize( dimension * count );
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+void
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::set( uint32_t n, const vector_type & centroid )
+{
+  vector_type whitened = whiten( centroid );
+  for ( int d = 0; d < dimension; ++d ) {
+    centroids_[d * count_ + n] = whitened[d];
+  }
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+void
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::assign(
+  const value_type * centroids,
+  uint32_t count,
+  uint32_t stride
+)
+{
+  resize( count );
+  vector_type centroid;
+  for ( uint32_t n = 0; n < count; ++n ) {
+    for ( int d = 0; d < dimension; ++d ) {
+      centroid[d] = centroids[d * stride + n];
+    }
+    set( n, centroid );
+  }
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+const typename GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::matrix_type &
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::whitening() const
+{
+  return whitening_;
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+typename GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::vector_type
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::whiten( const vector_type & v ) const
+{
+  return v * whitening_;
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+const typename GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::value_type *
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::centroids( int d ) const
+{
+  return &centroids_[d * count_];
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+typename GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::value_type
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::distance(
+  const vector_type & whitened,
+  uint32_t n
+) const
+{
+  value_type result = 0;
+  for ( int d = 0; d < dimension; ++d ) {
+    value_type diff = whitened[d] - centroids_[d * count_ + n];
+    result += diff * diff;
+  }
+  return result;
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+void
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::logLikelihoods(
+  const vector_type & v,
+  uint32_t first,
+  uint32_t count,
+  value_type * result
+) const
+{
+  if ( count == 0 ) {
+    return;
+  }
+  vector_type whitened = whiten( v );
+  Eigen::Map< array_type > r( result, count );
+  r = ( Eigen::Map< const array_type >( &centroids_[first], count ) - whitened[0] ).square();
+  for ( int d = 1; d < dimension; ++d ) {
+    r += (   Eigen::Map< const array_type >( &centroids_[d * count_ + first], count )
+           - whitened[d]
+         ).square();
+  }
+  r *= - 0.5;
+}
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+void
+GaussianKernel<T, MATRIX_TYPE, VECTOR_TYPE>::likelihoods(
+  const vector_type & v,
+  uint32_t first,
+  uint32_t count,
+  value_type floor,
+  value_type * result
+) const
+{
+  logLikelihoods( v, first, count, result );
+  Eigen::Map< array_type > r( result, count );
+  r = r.exp() + floor;
+}
@@ -0,0 +1,78 @@
+#ifndef GHMM_GAUSSIAN_KERNEL_HPP_
+#define GHMM_GAUSSIAN_KERNEL_HPP_
+
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Cholesky>
+#include <stdint.h>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// The Gaussians of Gaussian around many centroids, evaluated for one point
+// at a time. Centroids are kept in the coordinates of the Cholesky factor of
+// the inverse covariance, one array per dimension, so that the quadratic
+// form of every centroid is a sum of squares over contiguous memory and the
+// exponentials of a whole block are taken with the vectorized exp of Eigen.
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+class GaussianKernel
+{
+public:
+  typedef MATRIX_TYPE matrix_type;
+  typedef VECTOR_TYPE vector_type;
+  typedef T value_type;
+
+  explicit GaussianKernel( matrix_type sigma = matrix_type::Identity() );
+
+  uint32_t size() const;
+  // Centroids are undefined until set
+  void resize( uint32_t count );
+  void set( uint32_t n, const vector_type & centroid );
+  // Centroids stored as one array per dimension, stride values apart
+  void assign( const value_type * centroids, uint32_t count, uint32_t stride );
+
+  // Points of a whitened space, where the Mahalanobis distance is Euclidean
+  const matrix_type & whitening() const;
+  vector_type whiten( const vector_type & v ) const;
+  // Dimension d of every whitened centroid
+  const value_type * centroids( int d ) const;
+  // Squared Mahalanobis distance of a whitened point to centroid n
+  value_type distance( const vector_type & whitened, uint32_t n ) const;
+
+  // Centroids first to first + count, into result. Log-likelihoods have no
+  // normalization, likelihoods get the floor added.
+  void logLikelihoods(
+    const vector_type & v,
+    uint32_t first,
+    uint32_t count,
+    value_type * result
+  ) const;
+  void likelihoods(
+    const vector_type & v,
+    uint32_t first,
+    uint32_t count,
+    value_type floor,
+    value_type * result
+  ) const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+private:
+  enum { dimension = VECTOR_TYPE::SizeAtCompileTime };
+  typedef Eigen::Array< value_type, Eigen::Dynamic, 1 > array_type;
+
+  matrix_type whitening_;
+  uint32_t count_;
+  std::vector< value_type > centroids_;
+};
+
+
+#include "GaussianKernel-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_GAUSSIAN_KERNEL_HPP_
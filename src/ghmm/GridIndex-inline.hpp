@@ -0,0 +1,197 @@
+template < typename ITM_TRAITS >
+GridIndex<ITM_TRAITS>::GridIndex( const metric_type & metric, value_type cellSize )
+  : whitening_( metric.whitening() ),
+    cellSize_( cellSize ),
+    cells_(),
+    size_( 0 )
+{}
+
+template < typename ITM_TRAITS >
+void
+GridIndex<ITM_TRAITS>::insert( node_type n, const point_type & p )
+{
+  cells_[cellOf( p )].push_back( n );
+  ++size_;
+}
+
+template < typename ITM_TRAITS >
+void
+GridIndex<ITM_TRAITS>::erase( node_type n, const point_type & p )
+{
+  typename cell_map::iterator cell = cells_.find( cellOf( p ) );
+  assert( cell != cells_.end() );
+  bucket_type & bucket = cell->second;
+  typename bucket_type::iterator i = std::find( bucket.begin(), bucket.end(), n );
+  assert( i != bucket.end() );
+  *i = bucket.back();
+  bucket.pop_back();
+  if ( bucket.empty() ) {
+    cells_.erase( cell );
+  }
+  --size_;
+}
+
+template < typename ITM_TRAITS >
+void
+GridIndex<ITM_TRAITS>::move( 
+  node_type n, 
+  const point_type & from, 
+  const point_type & to 
+)
+{
+  if ( cellOf( from ) != cellOf( to ) ) {
+    erase( n, from );
+    insert( n, to );
+  }
+}
+
+template < typename ITM_TRAITS >
+void
+GridIndex<ITM_TRAITS>::renumber( node_type removed )
+{
+  // vecS shifts down every descriptor above the removed one
+  for ( typename cell_map::iterator cell = cells_.begin(); 
+        cell != cells_.end(); ++cell 
+  ) {
+    bucket_type & bucket = cell->second;
+    for ( typename bucket_type::iterator i = bucket.begin(); 
+          i != bucket.end(); ++i 
+    ) {
+      if ( *i > removed ) {
+        --*i;
+      }
+    }
+  }
+}
+
+template < typename ITM_TRAITS >
+void
+GridIndex<ITM_TRAITS>::clear()
+{
+  cells_.clear();
+  size_ = 0;
+}
+
+template < typename ITM_TRAITS >
+std::pair<typename GridIndex<ITM_TRAITS>::node_type, typename GridIndex<ITM_TRAITS>::node_type> 
+GridIndex<ITM_TRAITS>::findBest( 
+  const graph_type & graph, 
+  const metric_type & metric, 
+  const point_type & p 
+) const
+{
+  search_type search;
+  search.best = boost::graph_traits<graph_type>::null_vertex();
+  search.second = search.best;
+  search.bestDistance = std::numeric_limits<value_type>::max();
+  search.secondDistance = std::numeric_limits<value_type>::max();
+  search.visited = 0;
+
+  cell_type center = cellOf( p );
+
+  for ( int k = 0; search.visited < size_; ++k ) {
+    if ( ringSize( k ) > cells_.size() ) {
+      // The ring has more cells than there are occupied ones, scanning the
+      // remaining buckets is cheaper than enumerating it.
+      for ( typename cell_map::const_iterator cell = cells_.begin(); 
+            cell != cells_.end(); ++cell 
+      ) {
+        if ( ( cell->first - center ).cwiseAbs().maxCoeff() >= k ) {
+          visitBucket( cell->second, graph, metric, p, search );
+        }
+      }
+      break;
+    }
+    visitRing( center, k, graph, metric, p, search );
+
+    // Every unvisited centroid is at least k cells away. The margin absorbs
+    // rounding differences between the whitened and the Mahalanobis distance.
+    if ( search.secondDistance < metric.scale( k * cellSize_ * ( 1 - 1E-3 ) ) ) {
+      break;
+    }
+  }
+  return std::make_pair( search.best, search.second );
+}
+
+template < typename ITM_TRAITS >
+typename GridIndex<ITM_TRAITS>::cell_type
+GridIndex<ITM_TRAITS>::cellOf( const point_type & p ) const
+{
+  point_type w = p * whitening_;
+  cell_type result;
+  for ( int i = 0; i < dimension; ++i ) {
+    result[i] = static_cast<int>( std::floor( w[i] / cellSize_ ) );
+  }
+  return result;
+}
+
+template < typename ITM_TRAITS >
+double
+GridIndex<ITM_TRAITS>::ringSize( int k ) const
+{
+  if ( k == 0 ) {
+    return 1;
+  }
+  return std::pow( 2.0 * k + 1, dimension ) - std::pow( 2.0 * k - 1, dimension );
+}
+
+template < typename ITM_TRAITS >
+void
+GridIndex<ITM_TRAITS>::visitRing( 
+  const cell_type & center, 
+  int k, 
+  const graph_type & graph, 
+  const metric_type & metric, 
+  const point_type & p, 
+  search_type & search
+) const
+{
+  cell_type offset;
+  offset.setConstant( -k );
+  for ( ;; ) {
+    if ( offset.cwiseAbs().maxCoeff() == k ) {
+      typename cell_map::const_iterator cell = cells_.find( center + offset );
+      if ( cell != cells_.end() ) {
+        visitBucket( cell->second, graph, metric, p, search );
+      }
+    }
+    int i = 0;
+    while ( i < dimension && offset[i] == k ) {
+      offset[i] = -k;
+      ++i;
+    }
+    if ( i == dimension ) {
+      break;
+    }
+    ++offset[i];
+  }
+}
+
+template < typename ITM_TRAITS >
+void
+GridIndex<ITM_TRAITS>::visitBucket( 
+  const bucket_type & bucket, 
+  const graph_type & graph, 
+  const metric_type & metric, 
+  const point_type & p, 
+  search_type & search
+) const
+{
+  for ( typename bucket_type::const_iterator i = bucket.begin(); 
+        i != bucket.end(); ++i 
+  ) {
+    value_type d = metric( p, metric.at( graph, *i ) );
+    // Order by ( distance, descriptor ), which is the order in which a linear
+    // scan over vecS storage keeps the first of two equidistant nodes.
+    if ( d < search.bestDistance || ( d == search.bestDistance && *i < search.best ) ) {
+      search.second = search.best;
+      search.secondDistance = search.bestDistance;
+      search.best = *i;
+      search.bestDistance = d;
+    } else if ( d < search.secondDistance || ( d == search.secondDistance && *i < search.second ) ) {
+      search.second = *i;
+      search.secondDistance = d;
+    }
+    ++search.visited;
+  }
+}
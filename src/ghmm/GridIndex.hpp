@@ -0,0 +1,116 @@
+#ifndef GHMM_GRID_INDEX_HPP_
+#define GHMM_GRID_INDEX_HPP_
+
+
+#include <eigen3/Eigen/Core>
+#include <boost/graph/graph_traits.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Nearest-two-neighbour index that buckets centroids in a uniform grid laid
+// over whitened coordinates, so that cells are isotropic under the
+// Mahalanobis distance. Queries visit rings of cells around the observation
+// until no unvisited cell can hold something closer than the current second
+// best. Candidates are ranked with the ITM metric itself and ties are broken
+// by descriptor, so the result is exactly the one of a linear scan.
+template < typename ITM_TRAITS >
+class GridIndex
+{
+public:
+  typedef typename ITM_TRAITS::observation_type observation_type;
+  typedef typename ITM_TRAITS::matrix_type matrix_type;
+  typedef typename ITM_TRAITS::graph_type graph_type;
+  typedef typename ITM_TRAITS::value_type value_type;
+  typedef typename ITM_TRAITS::node_type node_type;
+  typedef typename ITM_TRAITS::metric_type metric_type;
+  typedef typename metric_type::point_type point_type;
+
+  // Points are those of the metric, see Metric.hpp
+  GridIndex( const metric_type & metric, value_type cellSize );
+
+  void insert( node_type n, const point_type & p );
+  void erase( node_type n, const point_type & p );
+  void move( 
+    node_type n, 
+    const point_type & from, 
+    const point_type & to 
+  );
+  void renumber( node_type removed );
+  void clear();
+
+  std::pair<node_type, node_type> findBest( 
+    const graph_type & graph, 
+    const metric_type & metric, 
+    const point_type & p 
+  ) const;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+private:
+  enum { dimension = observation_type::ColsAtCompileTime };
+  typedef Eigen::Matrix<int, 1, dimension> cell_type;
+
+  struct cell_hash {
+    std::size_t operator()( const cell_type & c ) const
+    {
+      return boost::hash_range( c.data(), c.data() + c.size() );
+    }
+  };
+
+  typedef std::vector<node_type> bucket_type;
+  typedef boost::unordered_map< 
+      cell_type, 
+      bucket_type, 
+      cell_hash, 
+      std::equal_to<cell_type>,
+      Eigen::aligned_allocator< std::pair<const cell_type, bucket_type> > 
+    > cell_map;
+
+  struct search_type {
+    node_type  best;
+    node_type  second;
+    value_type bestDistance;
+    value_type secondDistance;
+    std::size_t visited;
+  };
+
+  matrix_type whitening_;
+  value_type  cellSize_;
+  cell_map    cells_;
+  std::size_t size_;
+
+  cell_type cellOf( const point_type & p ) const;
+  double ringSize( int k ) const;
+  void visitRing( 
+    const cell_type & center, 
+    int k, 
+    const graph_type & graph, 
+    const metric_type & metric, 
+    const point_type & p, 
+    search_type & search
+  ) const;
+  void visitBucket( 
+    const bucket_type & bucket, 
+    const graph_type & graph, 
+    const metric_type & metric, 
+    const point_type & p, 
+    search_type & search
+  ) const;
+};
+
+
+#include "GridIndex-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_GRID_INDEX_HPP_
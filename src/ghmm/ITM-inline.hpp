@@ -5,36 +5,231 @@ ITM<ITM_TRAITS>::ITM(
   value_type insertionDistance, 
   value_type epsilon 
 ) : graph_( graph ),
-    distance_( distance ),
+    metric_( distance ),
+    index_( metric_, insertionDistance ),
     insertionDistance_( insertionDistance ),
     epsilon_( epsilon ),
     lastInserted_( boost::graph_traits<graph_type>::null_vertex() ),
-    none_( boost::graph_traits<graph_type>::null_vertex() )
+    none_( boost::graph_traits<graph_type>::null_vertex() ),
+    reshaped_( false )
 {
+  resetMoves();
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::reindex() 
+{
+  std::vector<node_type> moved;
+  nodes_.compact( graph_, moved );
+  fillIndex();
+  lastInserted_ = none_;
+  resetMoves();
+  dirty_ = pending_;
+  reshaped_ = true;
+}
+
+template< typename ITM_TRAITS >
+typename ITM<ITM_TRAITS>::value_type
+ITM<ITM_TRAITS>::insertionDistance() const
+{
+  return insertionDistance_;
+}
+
+template< typename ITM_TRAITS >
+typename ITM<ITM_TRAITS>::value_type
+ITM<ITM_TRAITS>::epsilon() const
+{
+  return epsilon_;
+}
+
+template< typename ITM_TRAITS >
+const std::vector<typename ITM<ITM_TRAITS>::node_type> &
+ITM<ITM_TRAITS>::compact()
+{
+  std::vector<node_type> moved;
+  if ( nodes_.compact( graph_, moved ) ) {
+    typename std::vector<node_type>::iterator p;
+    for ( p = pending_.begin(); p != pending_.end(); ++p ) {
+      if ( *p != none_ ) {
+        *p = moved[*p];
+      }
+    }
+    if ( lastInserted_ != none_ ) {
+      lastInserted_ = moved[lastInserted_];
+    }
+    renumberDirty( moved );
+    fillIndex();
+  }
+  moved_.swap( pending_ );
+  resetMoves();
+  return moved_;
+}
+
+template< typename ITM_TRAITS >
+const std::vector<typename ITM<ITM_TRAITS>::node_type> &
+ITM<ITM_TRAITS>::reorder( const std::vector<node_type> & order )
+{
+  assert( order.size() == boost::num_vertices( graph_ ) );
+
+  graph_type reordered;
+  moved_.assign( order.size(), none_ );
+  typename std::vector<node_type>::const_iterator n;
+  for ( n = order.begin(); n != order.end(); ++n ) {
+    assert( nodes_.live( *n ) && moved_[*n] == none_ );
+    moved_[*n] = boost::add_vertex( graph_[*n], reordered );
+  }
+  // Out-edges are added by source, in the new order
+  out_edge_iterator child;
+  out_edge_iterator childEnd;
+  for ( n = order.begin(); n != order.end(); ++n ) {
+    for ( boost::tie( child, childEnd ) = boost::out_edges( *n, graph_ );
+          child != childEnd; ++child
+    ) {
+      boost::add_edge( 
+        moved_[*n], 
+        moved_[boost::target( *child, graph_ )], 
+        graph_[*child], 
+        reordered 
+      );
+    }
+  }
+  graph_.swap( reordered );
+
+  if ( lastInserted_ != none_ ) {
+    lastInserted_ = moved_[lastInserted_];
+  }
+  renumberDirty( moved_ );
+  reshaped_ = true;
+  fillIndex();
+  resetMoves();
+  return moved_;
+}
+
+template< typename ITM_TRAITS >
+const std::vector<typename ITM<ITM_TRAITS>::node_type> &
+ITM<ITM_TRAITS>::dirty()
+{
+  std::sort( dirty_.begin(), dirty_.end() );
+  typename std::vector<node_type>::iterator end = 
+    std::unique( dirty_.begin(), dirty_.end() );
+  // Drops removed nodes, and the tombstones a node store keeps
+  typename std::vector<node_type>::iterator live = dirty_.begin();
+  typename std::vector<node_type>::iterator p;
+  for ( p = dirty_.begin(); p != end; ++p ) {
+    if ( *p != none_ && nodes_.live( *p ) ) {
+      *live++ = *p;
+    }
+  }
+  dirty_.erase( live, dirty_.end() );
+  return dirty_;
+}
+
+template< typename ITM_TRAITS >
+bool
+ITM<ITM_TRAITS>::reshaped() const
+{
+  return reshaped_;
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::clean()
+{
+  dirty_.clear();
+  reshaped_ = false;
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::touch( node_type n )
+{
+  dirty_.push_back( n );
+  // Without anybody cleaning, repeats are dropped once in a while so that
+  // the set does not grow past the graph
+  if ( dirty_.size() > 2 * boost::num_vertices( graph_ ) + 64 ) {
+    dirty();
+  }
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::renumberDirty( const std::vector<node_type> & moved )
+{
+  typename std::vector<node_type>::iterator p;
+  for ( p = dirty_.begin(); p != dirty_.end(); ++p ) {
+    if ( *p != none_ ) {
+      *p = *p < moved.size() ? moved[*p] : none_;
+    }
+  }
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::fillIndex()
+{
+  metric_.clear();
+  index_.clear();
+  node_iterator n;
+  node_iterator nodeEnd;
+  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ ); 
+        n != nodeEnd; ++n 
+  ) {
+    metric_.insert( *n, metric_.point( graph_[*n].centroid ) );
+    index_.insert( *n, metric_.at( graph_, *n ) );
+  }
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::resetMoves()
+{
+  pending_.resize( boost::num_vertices( graph_ ) );
+  node_iterator n;
+  node_iterator nodeEnd;
+  typename std::vector<node_type>::iterator p = pending_.begin();
+  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph_ ); 
+        n != nodeEnd; ++n, ++p
+  ) {
+    *p = *n;
+  }
+}
+
+template< typename ITM_TRAITS >
+typename ITM<ITM_TRAITS>::trace_type &
+ITM<ITM_TRAITS>::trace() const
+{
+  return trace_;
 }
 
 template< typename ITM_TRAITS >
 void
 ITM<ITM_TRAITS>::operator()( const observation_type & o ) 
+{
+  adapt( o );
+  trace_.size( boost::num_vertices( graph_ ), boost::num_edges( graph_ ) );
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::adapt( const observation_type & o ) 
 {
   node_type best;
   node_type second;
 
-  boost::tie( best, second ) = findBest( o );
+  // Mapped once, every comparison below is between points
+  point_type p = metric_.point( o );
+  boost::tie( best, second ) = index_.findBest( graph_, metric_, p );
 
   if ( best == none_ ) {
-    node_type n = boost::add_vertex( graph_ );
-    graph_[n].centroid = o;
-    std::cerr << "Add vertex: " << graph_[n].centroid << std::endl;
+    addNode( o, p );
     return;
   }
 
   if ( second == none_ ) {
-    if ( distance_( graph_[best].centroid, o ) > insertionDistance_ ) {
+    if ( metric_( metric_.at( graph_, best ), p ) > metric_.scale( insertionDistance_ ) ) {
       second = best;
-      best = boost::add_vertex( graph_ );
-      graph_[best].centroid = o;
-      std::cerr << "Add vertex: " << graph_[best].centroid << std::endl;
+      best = addNode( o, p );
     } else {
       return;
     }
@@ -42,82 +237,138 @@ ITM<ITM_TRAITS>::operator()( const observation_type & o )
 
   assert( best != second );
   // This assumes that graph do not handle parallel edges
-  observation_type & bestCentroid = graph_[best].centroid;
-  observation_type & secondCentroid = graph_[second].centroid;
-
-  if ( distance_( bestCentroid, secondCentroid ) < 2 * insertionDistance_ ) {
-    boost::add_edge( best, second, graph_ );
-    boost::add_edge( second, best, graph_ );
+  if (   metric_( metric_.at( graph_, best ), metric_.at( graph_, second ) ) 
+       < metric_.scale( 2 * insertionDistance_ ) 
+  ) {
+    addEdge( best, second );
+    addEdge( second, best );
   }
 
+  observation_type & bestCentroid = graph_[best].centroid;
+  point_type previous = metric_.at( graph_, best );
   bestCentroid += epsilon_ * ( o - bestCentroid );
+  metric_.update( graph_, best );
+  index_.move( best, previous, metric_.at( graph_, best ) );
+  touch( best );
 
   handleDeletions( best, second );
-  handleInsertions( o, best, second );
+  handleInsertions( o, p, best, second );
 }
 
 template< typename ITM_TRAITS >
-std::pair<typename ITM<ITM_TRAITS>::node_type, typename ITM<ITM_TRAITS>::node_type> 
-ITM<ITM_TRAITS>::findBest( const observation_type & o )
+typename ITM<ITM_TRAITS>::node_type
+ITM<ITM_TRAITS>::addNode( const observation_type & o, const point_type & p )
 {  
-  node_type none_ = boost::graph_traits<graph_type>::null_vertex();
-  node_iterator begin = boost::vertices( graph_ ).first;
-  node_iterator end = boost::vertices( graph_ ).second;
-  node_iterator best = end;
-  node_iterator second = end;
-  value_type bestDistance = std::numeric_limits<value_type>::max();
-  value_type secondDistance = std::numeric_limits<value_type>::max();
-  for ( node_iterator i = begin; i != end; ++i ) {
-    value_type distance = distance_( o, graph_[*i].centroid );
-    if ( distance < bestDistance ) {
-      second = best;
-      secondDistance = bestDistance;
-      best = i;
-      bestDistance = distance;
-    } else if ( distance < secondDistance ) {
-      second = i;
-      secondDistance = distance;
+  node_type n = nodes_.add( graph_ );
+  graph_[n].centroid = o;
+  metric_.insert( n, p );
+  index_.insert( n, p );
+  touch( n );
+  reshaped_ = true;
+  trace_.count( NODES_ADDED );
+  return n;
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::addEdge( node_type n1, node_type n2 )
+{  
+  // With a bidirectional graph, add_edge allocates even when the edge is
+  // there already
+  if ( ! boost::edge( n1, n2, graph_ ).second ) {
+    boost::add_edge( n1, n2, graph_ );
+    touch( n1 );
+    reshaped_ = true;
+    trace_.count( EDGES_ADDED );
+  }
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::removeEdge( node_type n1, node_type n2 )
+{  
+  if ( boost::edge( n1, n2, graph_ ).second ) {
+    boost::remove_edge( n1, n2, graph_ );
+    touch( n1 );
+    reshaped_ = true;
+    trace_.count( EDGES_REMOVED );
+  }
+}
+
+template< typename ITM_TRAITS >
+void
+ITM<ITM_TRAITS>::removeNode( node_type n )
+{  
+  index_.erase( n, metric_.at( graph_, n ) );
+  in_edge_iterator parent;
+  in_edge_iterator parentEnd;
+  for ( boost::tie( parent, parentEnd ) = boost::in_edges( n, graph_ );
+        parent != parentEnd; ++parent
+  ) {
+    touch( boost::source( *parent, graph_ ) );
+  }
+  uint32_t edgeCount = boost::num_edges( graph_ );
+  boost::clear_vertex( n, graph_ );
+  trace_.count( EDGES_REMOVED, edgeCount - boost::num_edges( graph_ ) );
+  nodes_.remove( graph_, n );
+  reshaped_ = true;
+
+  if ( node_store_type::stable ) {
+    if ( n < pending_.size() ) {
+      pending_[n] = none_;
+    }
+  } else {
+    index_.renumber( n );
+    metric_.renumber( n );
+    typename std::vector<node_type>::iterator p;
+    for ( p = pending_.begin(); p != pending_.end(); ++p ) {
+      node_store_type::renumber( n, *p );
+    }
+    for ( p = dirty_.begin(); p != dirty_.end(); ++p ) {
+      node_store_type::renumber( n, *p );
     }
   }
-  return std::make_pair( 
-    best == end ? none_ : *best, 
-    second == end ? none_ : *second 
-  );
+  node_store_type::renumber( n, lastInserted_ );
+  trace_.count( NODES_REMOVED );
 }
 
 template< typename ITM_TRAITS >
 void
-ITM<ITM_TRAITS>::handleDeletions( node_type best, node_type second )
+ITM<ITM_TRAITS>::handleDeletions( node_type & best, node_type & second )
 {  
-  observation_type & bestCentroid = graph_[best].centroid;
-  observation_type & secondCentroid = graph_[second].centroid;
+  const point_type & bestPoint = metric_.at( graph_, best );
+  const point_type & secondPoint = metric_.at( graph_, second );
 
   // Don't know of other way to avoid iterator invalidation than to do this
   // twice.
   out_edge_iterator iChild;
   out_edge_iterator eChild;
-  typename std::list<node_type> erase;
+  std::vector<node_type> & erase = erase_;
+  erase.clear();
 
   for ( boost::tie( iChild, eChild ) = boost::out_edges( best, graph_ );
         iChild != eChild; ++iChild
   ) {
     node_type child = boost::target( *iChild, graph_ );
     if ( child != best ) { // Do not try to delete self-edges
-      observation_type centroid = graph_[child].centroid;
-      observation_type center = ( bestCentroid + centroid ) * 0.5;
-      if (      distance_( center, secondCentroid )
-              < distance_( center, centroid )
+      const point_type & point = metric_.at( graph_, child );
+      point_type center = ( bestPoint + point ) * 0.5;
+      if (      metric_( center, secondPoint )
+              < metric_( center, point )
       ) {
         erase.push_back( child );
       }
     }
   }
 
-  typename std::list<node_type>::iterator iErase;
-  typename std::list<node_type>::iterator eErase = erase.end();
+  // Removing from the highest descriptor down keeps the pending ones valid
+  std::sort( erase.begin(), erase.end(), std::greater<node_type>() );
+
+  typename std::vector<node_type>::iterator iErase;
+  typename std::vector<node_type>::iterator eErase = erase.end();
   for ( iErase = erase.begin(); iErase != eErase; ++iErase ) {
-    boost::remove_edge( best, *iErase, graph_ );
-    boost::remove_edge( *iErase, best, graph_ );
+    removeEdge( best, *iErase );
+    removeEdge( *iErase, best );
 
     boost::tie( iChild, eChild ) = boost::out_edges( *iErase, graph_ );
 
@@ -126,40 +377,45 @@ ITM<ITM_TRAITS>::handleDeletions( node_type best, node_type second )
         || (    std::distance( iChild, eChild ) == 1 
              && boost::target( *iChild, graph_ ) == *iErase )
     ) {
-      boost::clear_vertex( *iErase, graph_ );
-      boost::remove_vertex( *iErase, graph_ );
+      removeNode( *iErase );
+      node_store_type::renumber( *iErase, best );
+      node_store_type::renumber( *iErase, second );
     }
   }
 }
 
 template< typename ITM_TRAITS >
 void
-ITM<ITM_TRAITS>::handleInsertions( const observation_type & o, node_type best, node_type second )
+ITM<ITM_TRAITS>::handleInsertions( 
+  const observation_type & o, 
+  const point_type & p, 
+  node_type best, 
+  node_type second 
+)
 {  
-  observation_type & bestCentroid = graph_[best].centroid;
-  observation_type & secondCentroid = graph_[second].centroid;
-  observation_type center = ( bestCentroid + secondCentroid ) * 0.5;
+  // Copies, adding a vertex may reallocate the vertex storage
+  point_type bestPoint = metric_.at( graph_, best );
+  point_type secondPoint = metric_.at( graph_, second );
+  point_type center = ( bestPoint + secondPoint ) * 0.5;
+  value_type insertion = metric_.scale( insertionDistance_ );
 
-  if (    (    distance_( center, secondCentroid ) < distance_( center, o ) 
-            || distance_( secondCentroid, o ) > insertionDistance_  )
-       && distance_( bestCentroid, o ) > insertionDistance_ 
+  if (    (    metric_( center, secondPoint ) < metric_( center, p ) 
+            || metric_( secondPoint, p ) > insertion  )
+       && metric_( bestPoint, p ) > insertion 
   ) {
-    node_type r = boost::add_vertex( graph_ );
-    graph_[r].centroid = o;
-    std::cerr << "Add vertex: " << graph_[r].centroid << std::endl;
+    node_type r = addNode( o, p );
     assert( best != r );
-    boost::add_edge( best, r, graph_ );
-    boost::add_edge( r, best, graph_ );
+    addEdge( best, r );
+    addEdge( r, best );
     if (  lastInserted_ != none_ 
          && r != lastInserted_
     ) {
-      boost::add_edge( r, lastInserted_, graph_ );
-      boost::add_edge( lastInserted_, r, graph_);
+      addEdge( r, lastInserted_ );
+      addEdge( lastInserted_, r );
     }
     lastInserted_ = r;
   } 
-  if ( distance_( bestCentroid, secondCentroid ) < 0.5 * insertionDistance_ ) {
-    boost::clear_vertex( second, graph_ );
-    boost::remove_vertex( second, graph_ );
+  if ( metric_( bestPoint, secondPoint ) < metric_.scale( 0.5 * insertionDistance_ ) ) {
+    removeNode( second );
   }
 }
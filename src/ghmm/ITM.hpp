@@ -2,10 +2,15 @@
 #define GHMM_ITM_H_
 
 
+#include "Trace.hpp"
+#include <eigen3/Eigen/Core>
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/graph_traits.hpp>
 #include <algorithm>
-#include <list>
+#include <cassert>
+#include <functional>
+#include <utility>
+#include <vector>
 
 
 namespace ghmm
@@ -25,6 +30,11 @@ public:
   typedef typename ITM_TRAITS::out_edge_iterator out_edge_iterator;
   typedef typename ITM_TRAITS::in_edge_iterator in_edge_iterator;
   typedef typename ITM_TRAITS::distance_type distance_type;
+  typedef typename ITM_TRAITS::metric_type metric_type;
+  typedef typename metric_type::point_type point_type;
+  typedef typename ITM_TRAITS::index_type index_type;
+  typedef typename ITM_TRAITS::node_store_type node_store_type;
+  typedef typename ITM_TRAITS::trace_type trace_type;
 
   ITM( 
     graph_type & graph, 
@@ -33,17 +43,68 @@ public:
     value_type epsilon 
   );
   void operator()( const observation_type & o );
+  // Rebuilds the index after nodes were added to the graph directly. Drops
+  // removed nodes first, so descriptors may change.
+  void reindex();
+
+  value_type insertionDistance() const;
+  value_type epsilon() const;
+  // Drops the removed nodes the node store still keeps, if any. Returns,
+  // for every node there was at the previous compaction, the descriptor it
+  // has now or null_vertex when it was removed. Nodes added since are not
+  // in it. Valid until the next call.
+  const std::vector<node_type> & compact();
+  // Stores the nodes in the order given, which holds every node once, and
+  // returns the descriptor every node has now, as compact() does. Edges and
+  // the properties of nodes and edges are kept. Removed nodes must have been
+  // compacted already.
+  const std::vector<node_type> & reorder( const std::vector<node_type> & order );
+  // Nodes added or moved since the last call to clean(), and those whose
+  // out-edges changed, sorted and each once. Descriptors are current ones.
+  const std::vector<node_type> & dirty();
+  // Whether nodes or edges were added or removed, or nodes renumbered, since
+  // the last call to clean(). Nodes that only moved leave it false.
+  bool reshaped() const;
+  void clean();
+  // Receives every change to the graph, see Trace.hpp. Recording does not
+  // change the map, so that const code can record too.
+  trace_type & trace() const;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 private:
   graph_type &  graph_;
-  distance_type distance_;
+  metric_type   metric_;
+  index_type    index_;
+  node_store_type nodes_;
   value_type    insertionDistance_;
   value_type    epsilon_;
   node_type     lastInserted_;
   node_type     none_;
+  std::vector<node_type> pending_;
+  std::vector<node_type> moved_;
+  // Scratch space of handleDeletions, kept to not allocate on every call
+  std::vector<node_type> erase_;
+  // May repeat nodes until dirty() is called
+  std::vector<node_type> dirty_;
+  bool                   reshaped_;
+  mutable trace_type     trace_;
 
-  std::pair<node_type, node_type> findBest( const observation_type & o  );
-  void handleDeletions( node_type best, node_type second );
-  void handleInsertions( const observation_type & o, node_type best, node_type second );
+  void adapt( const observation_type & o );
+  node_type addNode( const observation_type & o, const point_type & p );
+  void addEdge( node_type n1, node_type n2 );
+  void removeEdge( node_type n1, node_type n2 );
+  void removeNode( node_type n );
+  void touch( node_type n );
+  // Follows dirty nodes to their new descriptors, dropping removed ones
+  void renumberDirty( const std::vector<node_type> & moved );
+  void fillIndex();
+  void resetMoves();
+  void handleDeletions( node_type & best, node_type & second );
+  void handleInsertions( 
+    const observation_type & o, 
+    const point_type & p, 
+    node_type best, 
+    node_type second 
+  );
 };
 
 #include "ITM-inline.hpp"
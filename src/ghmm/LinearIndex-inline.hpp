@@ -0,0 +1,83 @@
+template < typename ITM_TRAITS >
+LinearIndex<ITM_TRAITS>::LinearIndex( const metric_type &, value_type )
+{}
+
+template < typename ITM_TRAITS >
+void
+LinearIndex<ITM_TRAITS>::insert( node_type n, const point_type & )
+{
+  if ( n < erased_.size() ) {
+    erased_[n] = false;
+  }
+}
+
+template < typename ITM_TRAITS >
+void
+LinearIndex<ITM_TRAITS>::erase( node_type n, const point_type & )
+{
+  if ( n >= erased_.size() ) {
+    erased_.resize( n + 1, false );
+  }
+  erased_[n] = true;
+}
+
+template < typename ITM_TRAITS >
+void
+LinearIndex<ITM_TRAITS>::move( 
+  node_type, 
+  const point_type &, 
+  const point_type & 
+)
+{}
+
+template < typename ITM_TRAITS >
+void
+LinearIndex<ITM_TRAITS>::renumber( node_type removed )
+{
+  if ( removed < erased_.size() ) {
+    erased_.erase( erased_.begin() + removed );
+  }
+}
+
+template < typename ITM_TRAITS >
+void
+LinearIndex<ITM_TRAITS>::clear()
+{
+  erased_.clear();
+}
+
+template < typename ITM_TRAITS >
+std::pair<typename LinearIndex<ITM_TRAITS>::node_type, typename LinearIndex<ITM_TRAITS>::node_type> 
+LinearIndex<ITM_TRAITS>::findBest( 
+  const graph_type & graph, 
+  const metric_type & metric, 
+  const point_type & p 
+) const
+{  
+  node_type none = boost::graph_traits<graph_type>::null_vertex();
+  node_iterator begin = boost::vertices( graph ).first;
+  node_iterator end = boost::vertices( graph ).second;
+  node_iterator best = end;
+  node_iterator second = end;
+  value_type bestDistance = std::numeric_limits<value_type>::max();
+  value_type secondDistance = std::numeric_limits<value_type>::max();
+  for ( node_iterator i = begin; i != end; ++i ) {
+    if ( *i < erased_.size() && erased_[*i] ) {
+      continue;
+    }
+    value_type d = metric( p, metric.at( graph, *i ) );
+    if ( d < bestDistance ) {
+      second = best;
+      secondDistance = bestDistance;
+      best = i;
+      bestDistance = d;
+    } else if ( d < secondDistance ) {
+      second = i;
+      secondDistance = d;
+    }
+  }
+  return std::make_pair( 
+    best == end ? none : *best, 
+    second == end ? none : *second 
+  );
+}
@@ -0,0 +1,58 @@
+#ifndef GHMM_LINEAR_INDEX_HPP_
+#define GHMM_LINEAR_INDEX_HPP_
+
+
+#include <boost/graph/graph_traits.hpp>
+#include <limits>
+#include <utility>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Nearest-two-neighbour index that scans every vertex. It only keeps which
+// vertices were erased, which a stable node store leaves in the graph.
+template < typename ITM_TRAITS >
+class LinearIndex
+{
+public:
+  typedef typename ITM_TRAITS::observation_type observation_type;
+  typedef typename ITM_TRAITS::graph_type graph_type;
+  typedef typename ITM_TRAITS::value_type value_type;
+  typedef typename ITM_TRAITS::node_type node_type;
+  typedef typename ITM_TRAITS::node_iterator node_iterator;
+  typedef typename ITM_TRAITS::metric_type metric_type;
+  typedef typename metric_type::point_type point_type;
+
+  // Points are those of the metric, see Metric.hpp
+  LinearIndex( const metric_type & metric, value_type cellSize );
+
+  void insert( node_type n, const point_type & p );
+  void erase( node_type n, const point_type & p );
+  void move( 
+    node_type n, 
+    const point_type & from, 
+    const point_type & to 
+  );
+  void renumber( node_type removed );
+  void clear();
+
+  std::pair<node_type, node_type> findBest( 
+    const graph_type & graph, 
+    const metric_type & metric, 
+    const point_type & p 
+  ) const;
+private:
+  std::vector<bool> erased_;
+};
+
+
+#include "LinearIndex-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_LINEAR_INDEX_HPP_
@@ -5,8 +5,15 @@ Mahalanobis<T, MATRIX_TYPE, VECTOR_TYPE>::Mahalanobis( matrix_type sigma )
 
 template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
 typename Mahalanobis<T, MATRIX_TYPE, VECTOR_TYPE>::value_type
-Mahalanobis<T, MATRIX_TYPE, VECTOR_TYPE>::operator()( const vector_type & v1, const vector_type & v2 )
+Mahalanobis<T, MATRIX_TYPE, VECTOR_TYPE>::operator()( const vector_type & v1, const vector_type & v2 ) const
 {
   vector_type diff = v1 - v2;
   return pow( diff * sigmaInverse_ * diff.transpose(), 0.5 );
 }
+
+template < typename T, typename MATRIX_TYPE, typename VECTOR_TYPE >
+const typename Mahalanobis<T, MATRIX_TYPE, VECTOR_TYPE>::matrix_type &
+Mahalanobis<T, MATRIX_TYPE, VECTOR_TYPE>::sigmaInverse() const
+{
+  return sigmaInverse_;
+}
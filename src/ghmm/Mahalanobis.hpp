@@ -2,6 +2,9 @@
 #define GHMM_MAHALANOBIS_HPP_
 
 
+#include <eigen3/Eigen/Core>
+
+
 namespace ghmm
 {
 
@@ -15,8 +18,10 @@ public:
   typedef T value_type;
 
   Mahalanobis( matrix_type sigma );
-  value_type operator()( const vector_type & v1, const vector_type & v2 );
+  value_type operator()( const vector_type & v1, const vector_type & v2 ) const;
+  const matrix_type & sigmaInverse() const;
   
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 private:
   matrix_type sigmaInverse_;
 };
@@ -2,6 +2,9 @@
 #define GHMM_MAHALANOBIS_2_HPP_
 
 
+#include <eigen3/Eigen/Core>
+
+
 namespace ghmm
 {
 
@@ -17,6 +20,7 @@ public:
   Mahalanobis2( matrix_type sigma );
   value_type operator()( const vector_type & v1, const vector_type & v2 );
   
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 private:
   matrix_type sigmaInverse_;
 };
@@ -0,0 +1,118 @@
+template < typename ITM_TRAITS >
+MahalanobisMetric<ITM_TRAITS>::MahalanobisMetric( const distance_type & distance )
+  : distance_( distance )
+{}
+
+template < typename ITM_TRAITS >
+const typename MahalanobisMetric<ITM_TRAITS>::point_type &
+MahalanobisMetric<ITM_TRAITS>::point( const observation_type & o ) const
+{
+  return o;
+}
+
+template < typename ITM_TRAITS >
+const typename MahalanobisMetric<ITM_TRAITS>::point_type &
+MahalanobisMetric<ITM_TRAITS>::at( const graph_type & graph, node_type n ) const
+{
+  return graph[n].centroid;
+}
+
+template < typename ITM_TRAITS >
+typename MahalanobisMetric<ITM_TRAITS>::value_type
+MahalanobisMetric<ITM_TRAITS>::operator()(
+  const point_type & p1,
+  const point_type & p2
+) const
+{
+  return distance_( p1, p2 );
+}
+
+template < typename ITM_TRAITS >
+typename MahalanobisMetric<ITM_TRAITS>::value_type
+MahalanobisMetric<ITM_TRAITS>::scale( value_type d ) const
+{
+  return d;
+}
+
+template < typename ITM_TRAITS >
+typename MahalanobisMetric<ITM_TRAITS>::matrix_type
+MahalanobisMetric<ITM_TRAITS>::whitening() const
+{
+  return Eigen::LLT<matrix_type>( distance_.sigmaInverse() ).matrixL();
+}
+
+template < typename ITM_TRAITS >
+WhitenedMetric<ITM_TRAITS>::WhitenedMetric( const distance_type & distance )
+  : whitening_( Eigen::LLT<matrix_type>( distance.sigmaInverse() ).matrixL() ),
+    points_()
+{}
+
+template < typename ITM_TRAITS >
+typename WhitenedMetric<ITM_TRAITS>::point_type
+WhitenedMetric<ITM_TRAITS>::point( const observation_type & o ) const
+{
+  return o * whitening_;
+}
+
+template < typename ITM_TRAITS >
+const typename WhitenedMetric<ITM_TRAITS>::point_type &
+WhitenedMetric<ITM_TRAITS>::at( const graph_type &, node_type n ) const
+{
+  return points_[n];
+}
+
+template < typename ITM_TRAITS >
+typename WhitenedMetric<ITM_TRAITS>::value_type
+WhitenedMetric<ITM_TRAITS>::operator()(
+  const point_type & p1,
+  const point_type & p2
+) const
+{
+  return ( p1 - p2 ).squaredNorm();
+}
+
+template < typename ITM_TRAITS >
+typename WhitenedMetric<ITM_TRAITS>::value_type
+WhitenedMetric<ITM_TRAITS>::scale( value_type d ) const
+{
+  return d * d;
+}
+
+template < typename ITM_TRAITS >
+typename WhitenedMetric<ITM_TRAITS>::matrix_type
+WhitenedMetric<ITM_TRAITS>::whitening() const
+{
+  return matrix_type::Identity();
+}
+
+template < typename ITM_TRAITS >
+void
+WhitenedMetric<ITM_TRAITS>::insert( node_type n, const point_type & p )
+{
+  if ( n >= points_.size() ) {
+    points_.resize( n + 1 );
+  }
+  points_[n] = p;
+}
+
+template < typename ITM_TRAITS >
+void
+WhitenedMetric<ITM_TRAITS>::update( const graph_type & graph, node_type n )
+{
+  points_[n] = graph[n].centroid * whitening_;
+}
+
+template < typename ITM_TRAITS >
+void
+WhitenedMetric<ITM_TRAITS>::renumber( node_type removed )
+{
+  // vecS shifts down every descriptor above the removed one
+  points_.erase( points_.begin() + removed );
+}
+
+template < typename ITM_TRAITS >
+void
+WhitenedMetric<ITM_TRAITS>::clear()
+{
+  points_.clear();
+}
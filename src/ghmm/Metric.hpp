@@ -0,0 +1,98 @@
+#ifndef GHMM_METRIC_HPP_
+#define GHMM_METRIC_HPP_
+
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Cholesky>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Metric policies decide in which coordinates the ITM compares centroids,
+// and how. Every observation is mapped to a point once, the point of every
+// node is kept by the metric, and distances between points are only ever
+// compared, with each other or with a scaled insertion distance.
+
+// Compares the centroids of the graph with the distance of the traits
+template < typename ITM_TRAITS >
+class MahalanobisMetric
+{
+public:
+  typedef typename ITM_TRAITS::observation_type observation_type;
+  typedef typename ITM_TRAITS::observation_type point_type;
+  typedef typename ITM_TRAITS::matrix_type matrix_type;
+  typedef typename ITM_TRAITS::graph_type graph_type;
+  typedef typename ITM_TRAITS::value_type value_type;
+  typedef typename ITM_TRAITS::node_type node_type;
+  typedef typename ITM_TRAITS::distance_type distance_type;
+
+  MahalanobisMetric( const distance_type & distance );
+
+  const point_type & point( const observation_type & o ) const;
+  const point_type & at( const graph_type & graph, node_type n ) const;
+  value_type operator()( const point_type & p1, const point_type & p2 ) const;
+  // A distance in the units operator() returns
+  value_type scale( value_type d ) const;
+  // Maps points to coordinates where the metric is Euclidean
+  matrix_type whitening() const;
+
+  // Points are the centroids themselves, there is nothing to keep
+  void insert( node_type, const point_type & ) {}
+  void update( const graph_type &, node_type ) {}
+  void renumber( node_type ) {}
+  void clear() {}
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+private:
+  distance_type distance_;
+};
+
+
+// Keeps the centroids in the coordinates of the Cholesky factor of the
+// inverse covariance, where the Mahalanobis distance is the Euclidean one.
+// Distances are squared, so comparing them takes neither a matrix product
+// nor a square root. Decisions only differ from MahalanobisMetric where
+// rounding breaks a tie differently.
+template < typename ITM_TRAITS >
+class WhitenedMetric
+{
+public:
+  typedef typename ITM_TRAITS::observation_type observation_type;
+  typedef typename ITM_TRAITS::observation_type point_type;
+  typedef typename ITM_TRAITS::matrix_type matrix_type;
+  typedef typename ITM_TRAITS::graph_type graph_type;
+  typedef typename ITM_TRAITS::value_type value_type;
+  typedef typename ITM_TRAITS::node_type node_type;
+  typedef typename ITM_TRAITS::distance_type distance_type;
+
+  WhitenedMetric( const distance_type & distance );
+
+  point_type point( const observation_type & o ) const;
+  const point_type & at( const graph_type & graph, node_type n ) const;
+  value_type operator()( const point_type & p1, const point_type & p2 ) const;
+  value_type scale( value_type d ) const;
+  matrix_type whitening() const;
+
+  void insert( node_type n, const point_type & p );
+  // Follows the centroid of n after it moved
+  void update( const graph_type & graph, node_type n );
+  void renumber( node_type removed );
+  void clear();
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+private:
+  typedef std::vector< point_type, Eigen::aligned_allocator< point_type > > point_array;
+
+  matrix_type whitening_;
+  point_array points_;
+};
+
+
+#include "Metric-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_METRIC_HPP_
@@ -0,0 +1,112 @@
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+ModelSnapshot<T, N, FULL_N, GHMM_TRAITS>::ModelSnapshot(
+  const ghmm_type & ghmm,
+  uint64_t version
+) : model_( ghmm.model() ),
+    version_( version ),
+    nodes_()
+{
+  const std::vector< uint64_t > & serials = ghmm.serials();
+  assert( serials.size() == model_.nodeCount() );
+  nodes_.reserve( serials.size() );
+  for ( uint32_t n = 0; n < serials.size(); ++n ) {
+    nodes_.push_back( serial_type( serials[n], n ) );
+  }
+  std::sort( nodes_.begin(), nodes_.end() );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+const typename ModelSnapshot<T, N, FULL_N, GHMM_TRAITS>::model_type &
+ModelSnapshot<T, N, FULL_N, GHMM_TRAITS>::model() const
+{
+  return model_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint64_t
+ModelSnapshot<T, N, FULL_N, GHMM_TRAITS>::version() const
+{
+  return version_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+ModelSnapshot<T, N, FULL_N, GHMM_TRAITS>::remap(
+  const ModelSnapshot & from,
+  track_type & track
+) const
+{
+  assert( track.nodeCount == from.model_.nodeCount() );
+  typedef typename model_type::numerics_type numerics_type;
+
+  // Both sides are sorted by serial, one merge pass finds the nodes that
+  // stayed. The scratch row of the track holds the new belief.
+  typename track_type::value_array & belief = track.likelihoods;
+  belief.assign( model_.nodeCount(), numerics_type::floor() );
+  value_type total = model_.nodeCount() * numerics_type::floor();
+  bool stayed = false;
+
+  typename serial_array::const_iterator i = from.nodes_.begin();
+  typename serial_array::const_iterator j = nodes_.begin();
+  while ( i != from.nodes_.end() && j != nodes_.end() ) {
+    if ( i->first < j->first ) {
+      ++i;
+    } else if ( j->first < i->first ) {
+      ++j;
+    } else {
+      value_type b = std::max( track.belief( i->second ), numerics_type::floor() );
+      total += b - belief[j->second];
+      belief[j->second] = b;
+      stayed = true;
+      ++i;
+      ++j;
+    }
+  }
+
+  if ( ! stayed ) {
+    model_.initTrack( track );
+    return;
+  }
+  for ( uint32_t n = 0; n < belief.size(); ++n ) {
+    belief[n] /= total;
+  }
+  track.nodeCount = model_.nodeCount();
+  track.estimations.swap( belief );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+ModelHandle<T, N, FULL_N, GHMM_TRAITS>::ModelHandle( const ghmm_type & ghmm )
+  : current_( new snapshot_type( ghmm, 0 ) )
+{}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+ModelHandle<T, N, FULL_N, GHMM_TRAITS>::publish( const ghmm_type & ghmm )
+{
+  // The snapshot is built before anyone can see it
+  snapshot_ptr next( new snapshot_type( ghmm, pin()->version() + 1 ) );
+  boost::atomic_store( &current_, next );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename ModelHandle<T, N, FULL_N, GHMM_TRAITS>::snapshot_ptr
+ModelHandle<T, N, FULL_N, GHMM_TRAITS>::pin() const
+{
+  return boost::atomic_load( &current_ );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+bool
+ModelHandle<T, N, FULL_N, GHMM_TRAITS>::refresh(
+  snapshot_ptr & pinned,
+  track_type & track
+) const
+{
+  snapshot_ptr latest = pin();
+  if ( latest->version() <= pinned->version() ) {
+    return false;
+  }
+  latest->remap( *pinned, track );
+  pinned = latest;
+  return true;
+}
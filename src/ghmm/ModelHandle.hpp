@@ -0,0 +1,88 @@
+#ifndef GHMM_MODEL_HANDLE_HPP_
+#define GHMM_MODEL_HANDLE_HPP_
+
+
+#include "GHMM.hpp"
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Compiled model published by a ModelHandle, never changed afterwards. Its
+// nodes carry the serials the learner gave them, see GHMM::serials, so that
+// beliefs can be moved from one snapshot to a later one.
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS = GHMMDefaultTraits< T, N, FULL_N > >
+class ModelSnapshot
+{
+public:
+  typedef GHMM<T, N, FULL_N, GHMM_TRAITS> ghmm_type;
+  typedef typename ghmm_type::compiled_type model_type;
+  typedef typename model_type::track_type track_type;
+  typedef typename model_type::value_type value_type;
+
+  ModelSnapshot( const ghmm_type & ghmm, uint64_t version );
+
+  const model_type & model() const;
+  // Snapshots published later have higher versions
+  uint64_t version() const;
+  // Moves a track of an earlier snapshot to this one. Nodes that are gone
+  // take their part of the belief with them, new nodes start at the floor.
+  // When no node is left the track starts over. Estimations ahead are
+  // dropped, they must be predicted again.
+  void remap( const ModelSnapshot & from, track_type & track ) const;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+private:
+  typedef std::pair< uint64_t, uint32_t > serial_type;
+  typedef typename std::vector< serial_type > serial_array;
+
+  model_type   model_;
+  uint64_t     version_;
+  // Serial and index of every node, sorted by serial
+  serial_array nodes_;
+};
+
+
+// Shares the latest model of a learner with any number of tracking threads.
+// The learner owns its GHMM, nobody else reads it, and publishes a snapshot
+// after learning. Trackers pin the latest snapshot and keep using it for as
+// long as they hold it, so they never wait for learning or compilation and
+// the learner never waits for them. Publishing and pinning swap a shared
+// pointer atomically; the last tracker to release a snapshot frees it.
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS = GHMMDefaultTraits< T, N, FULL_N > >
+class ModelHandle
+{
+public:
+  typedef ModelSnapshot<T, N, FULL_N, GHMM_TRAITS> snapshot_type;
+  typedef boost::shared_ptr< const snapshot_type > snapshot_ptr;
+  typedef typename snapshot_type::ghmm_type ghmm_type;
+  typedef typename snapshot_type::track_type track_type;
+
+  explicit ModelHandle( const ghmm_type & ghmm );
+
+  // Only called from the learner, one thread at a time
+  void publish( const ghmm_type & ghmm );
+  // The latest snapshot, from any thread
+  snapshot_ptr pin() const;
+  // Moves a single track to the latest snapshot when pinned is older and
+  // pins that one instead. Returns whether it did. Tracks that share a
+  // snapshot are moved together with pin and ModelSnapshot::remap.
+  bool refresh( snapshot_ptr & pinned, track_type & track ) const;
+private:
+  snapshot_ptr current_;
+};
+
+
+#include "ModelHandle-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_MODEL_HANDLE_HPP_
@@ -0,0 +1,290 @@
+namespace detail
+{
+  inline uint64_t alignModelOffset( uint64_t offset )
+  {
+    return ( offset + ModelImage::alignment - 1 ) / ModelImage::alignment * ModelImage::alignment;
+  }
+
+  struct model_unmapper {
+    model_unmapper( std::size_t size ) : size( size ) {}
+    void operator()( char * data ) const
+    {
+      munmap( data, size );
+    }
+    std::size_t size;
+  };
+}
+
+inline
+ModelImage::ModelImage()
+  : data_()
+{}
+
+inline
+ModelImage::ModelImage(
+  const header_type & header,
+  const uint64_t counts[SECTION_COUNT],
+  const uint32_t elementSizes[SECTION_COUNT]
+) : data_()
+{
+  section_type sections[SECTION_COUNT];
+  uint64_t offset = sizeof( header_type ) + sizeof( sections );
+  for ( uint32_t i = 0; i < SECTION_COUNT; ++i ) {
+    offset = detail::alignModelOffset( offset );
+    sections[i].offset = offset;
+    sections[i].count = counts[i];
+    sections[i].elementSize = elementSizes[i];
+    sections[i].reserved = 0;
+    offset += counts[i] * elementSizes[i];
+  }
+  uint64_t size = detail::alignModelOffset( offset );
+
+  void * data = 0;
+  if ( posix_memalign( &data, alignment, size ) != 0 ) {
+    throw std::bad_alloc();
+  }
+  data_.reset( static_cast<char *>( data ), std::free );
+  std::memset( data, 0, size );
+
+  header_type & h = *reinterpret_cast<header_type *>( data_.get() );
+  h = header;
+  h.magic = magic;
+  h.version = version;
+  h.sectionCount = SECTION_COUNT;
+  h.reserved = 0;
+  h.size = size;
+  std::memcpy( data_.get() + sizeof( header_type ), sections, sizeof( sections ) );
+}
+
+inline
+ModelImage
+ModelImage::map( const std::string & path )
+{
+  if ( ! littleEndian() ) {
+    throw std::runtime_error( "Model files can only be mapped on little endian hosts" );
+  }
+  int fd = open( path.c_str(), O_RDONLY );
+  if ( fd < 0 ) {
+    throw std::runtime_error( "Unable to open model file " + path );
+  }
+  struct stat status;
+  if ( fstat( fd, &status ) != 0 || status.st_size < off_t( sizeof( header_type ) ) ) {
+    close( fd );
+    throw std::runtime_error( "Invalid model file " + path );
+  }
+  std::size_t size = status.st_size;
+  void * data = mmap( 0, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if ( data == MAP_FAILED ) {
+    throw std::runtime_error( "Unable to map model file " + path );
+  }
+
+  ModelImage result;
+  result.data_.reset( static_cast<char *>( data ), detail::model_unmapper( size ) );
+  result.validate( size );
+  return result;
+}
+
+inline
+ModelImage
+ModelImage::read( const std::string & path )
+{
+  std::ifstream file( path.c_str(), std::ios::binary );
+  if ( ! file ) {
+    throw std::runtime_error( "Unable to open model file " + path );
+  }
+  file.seekg( 0, std::ios::end );
+  uint64_t size = file.tellg();
+  file.seekg( 0, std::ios::beg );
+  if ( size < sizeof( header_type ) ) {
+    throw std::runtime_error( "Invalid model file " + path );
+  }
+
+  void * data = 0;
+  if ( posix_memalign( &data, alignment, size ) != 0 ) {
+    throw std::bad_alloc();
+  }
+  ModelImage result;
+  result.data_.reset( static_cast<char *>( data ), std::free );
+  if ( ! file.read( result.data_.get(), size ) ) {
+    throw std::runtime_error( "Unable to read model file " + path );
+  }
+
+  if ( ! littleEndian() ) {
+    swapHeader( result.data_.get() );
+    const header_type & header = result.header();
+    if (    header.magic != magic
+         || header.sectionCount != SECTION_COUNT
+         || size < sizeof( header_type ) + SECTION_COUNT * sizeof( section_type )
+    ) {
+      throw std::runtime_error( "Invalid model file " + path );
+    }
+    swapSections( result.data_.get() );
+    result.validate( size );
+    for ( uint32_t i = 0; i < SECTION_COUNT; ++i ) {
+      const section_type & s = result.entry( section_id( i ) );
+      swap( result.data_.get() + s.offset, s.elementSize, s.count );
+    }
+  }
+  result.validate( size );
+  return result;
+}
+
+inline
+void
+ModelImage::save( const std::string & path ) const
+{
+  assert( data_ );
+  const char * data = data_.get();
+  uint64_t size = header().size;
+
+  std::vector<char> swapped;
+  if ( ! littleEndian() ) {
+    swapped.assign( data, data + size );
+    for ( uint32_t i = 0; i < SECTION_COUNT; ++i ) {
+      const section_type & s = entry( section_id( i ) );
+      swap( &swapped[s.offset], s.elementSize, s.count );
+    }
+    swapSections( &swapped[0] );
+    swapHeader( &swapped[0] );
+    data = &swapped[0];
+  }
+
+  std::ofstream file( path.c_str(), std::ios::binary );
+  if ( ! file.write( data, size ) || ! file.flush() ) {
+    throw std::runtime_error( "Unable to write model file " + path );
+  }
+}
+
+inline
+const ModelImage::header_type &
+ModelImage::header() const
+{
+  return *reinterpret_cast<const header_type *>( data_.get() );
+}
+
+inline
+uint64_t
+ModelImage::count( section_id id ) const
+{
+  return entry( id ).count;
+}
+
+inline
+bool
+ModelImage::empty() const
+{
+  return ! data_;
+}
+
+template < typename V >
+const V *
+ModelImage::section( section_id id ) const
+{
+  check( id, sizeof( V ) );
+  return reinterpret_cast<const V *>( data_.get() + entry( id ).offset );
+}
+
+template < typename V >
+V *
+ModelImage::section( section_id id )
+{
+  check( id, sizeof( V ) );
+  return reinterpret_cast<V *>( data_.get() + entry( id ).offset );
+}
+
+template < typename M >
+M
+ModelImage::matrix( section_id id ) const
+{
+  M result;
+  if ( count( id ) != uint64_t( result.rows() * result.cols() ) ) {
+    throw std::runtime_error( "Model file matrix has the wrong dimensions" );
+  }
+  const typename M::Scalar * values = section< typename M::Scalar >( id );
+  for ( int i = 0; i < result.rows(); ++i ) {
+    for ( int j = 0; j < result.cols(); ++j ) {
+      result( i, j ) = values[i * result.cols() + j];
+    }
+  }
+  return result;
+}
+
+inline
+const ModelImage::section_type &
+ModelImage::entry( section_id id ) const
+{
+  assert( data_ );
+  return reinterpret_cast<const section_type *>( data_.get() + sizeof( header_type ) )[id];
+}
+
+inline
+void
+ModelImage::check( section_id id, uint32_t elementSize ) const
+{
+  if ( entry( id ).count > 0 && entry( id ).elementSize != elementSize ) {
+    throw std::runtime_error( "Model file section has the wrong element type" );
+  }
+}
+
+inline
+void
+ModelImage::validate( uint64_t size ) const
+{
+  // Only the layout is checked here, CompiledGHMM checks the offsets and
+  // indices it reads
+  const header_type & h = header();
+  if (    h.magic != magic
+       || h.version != version
+       || h.sectionCount != SECTION_COUNT
+       || h.size != size
+       || size < sizeof( header_type ) + SECTION_COUNT * sizeof( section_type )
+  ) {
+    throw std::runtime_error( "Invalid or unsupported model file" );
+  }
+  for ( uint32_t i = 0; i < SECTION_COUNT; ++i ) {
+    const section_type & s = entry( section_id( i ) );
+    if (    s.offset % alignment != 0
+         || s.offset > size
+         || ( s.elementSize != 0 && s.count > ( size - s.offset ) / s.elementSize )
+    ) {
+      throw std::runtime_error( "Invalid model file section" );
+    }
+  }
+}
+
+inline
+bool
+ModelImage::littleEndian()
+{
+  uint16_t probe = 1;
+  return *reinterpret_cast<const char *>( &probe ) == 1;
+}
+
+inline
+void
+ModelImage::swap( char * data, uint32_t elementSize, uint64_t count )
+{
+  for ( uint64_t i = 0; i < count; ++i, data += elementSize ) {
+    std::reverse( data, data + elementSize );
+  }
+}
+
+inline
+void
+ModelImage::swapHeader( char * data )
+{
+  swap( data, sizeof( uint32_t ), 8 );
+  swap( data + 8 * sizeof( uint32_t ), sizeof( uint64_t ), 1 );
+}
+
+inline
+void
+ModelImage::swapSections( char * data )
+{
+  data += sizeof( header_type );
+  for ( uint32_t i = 0; i < SECTION_COUNT; ++i, data += sizeof( section_type ) ) {
+    swap( data, sizeof( uint64_t ), 2 );
+    swap( data + 2 * sizeof( uint64_t ), sizeof( uint32_t ), 2 );
+  }
+}
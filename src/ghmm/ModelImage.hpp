@@ -0,0 +1,133 @@
+#ifndef GHMM_MODEL_IMAGE_HPP_
+#define GHMM_MODEL_IMAGE_HPP_
+
+
+#include <boost/shared_ptr.hpp>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Memory image of a model, laid out exactly as the model file. The file is a
+// header, a table of sections and the sections themselves. Every field is
+// little endian and every section starts on a 64 byte boundary, so that a
+// mapped file can be used in place on little endian hosts. Images are
+// immutable once built and are shared by copies.
+class ModelImage
+{
+public:
+  enum { magic = 0x4d4d4847 }; // "GHMM"
+  enum { version = 1 };
+  enum { alignment = 64 };
+
+  // Sections of version 1. The first block is all inference needs, see
+  // CompiledGHMM, the second one holds the learning state, see GHMM.
+  enum section_id {
+    OBSERVATION_SIGMA,
+    GOAL_SIGMA,
+    CENTROIDS,
+    PRIOR,
+    IN_OFFSETS,
+    SOURCES,
+    TRANSITIONS,
+    OUT_OFFSETS,
+    TARGETS,
+    OUT_TRANSITIONS,
+    CELLS,
+    CELL_OFFSETS,
+    CELL_NODES,
+    FULL_SIGMA,
+    PARAMETERS,
+    PROBABILITY_SUMS,
+    NUMERATOR_SUMS,
+    DENOMINATOR_SUMS,
+    SECTION_COUNT
+  };
+
+  struct header_type {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t valueSize;
+    uint32_t observationDimension;
+    uint32_t fullDimension;
+    uint32_t trajectoryCount;
+    uint32_t sectionCount;
+    uint32_t reserved;
+    uint64_t size;
+  };
+
+  struct section_type {
+    uint64_t offset;
+    uint64_t count;
+    uint32_t elementSize;
+    uint32_t reserved;
+  };
+
+  ModelImage();
+
+  // Allocates an image with the given element count and size per section,
+  // the caller fills in the sections.
+  ModelImage(
+    const header_type & header,
+    const uint64_t counts[SECTION_COUNT],
+    const uint32_t elementSizes[SECTION_COUNT]
+  );
+
+  // Maps a file read only. Throws std::runtime_error when the file can not
+  // be mapped, is not a model file, or when the host is big endian.
+  static ModelImage map( const std::string & path );
+  // Reads a file into memory, converting it to the byte order of the host.
+  static ModelImage read( const std::string & path );
+  void save( const std::string & path ) const;
+
+  const header_type & header() const;
+  uint64_t count( section_id id ) const;
+  bool empty() const;
+
+  // Typed access to a section, throws std::runtime_error when the size of
+  // the elements does not match.
+  template < typename V >
+  const V * section( section_id id ) const;
+
+  template < typename V >
+  V * section( section_id id );
+
+  // Reads a row major matrix section, checking its dimensions
+  template < typename M >
+  M matrix( section_id id ) const;
+private:
+  boost::shared_ptr<char> data_;
+
+  const section_type & entry( section_id id ) const;
+  void check( section_id id, uint32_t elementSize ) const;
+  void validate( uint64_t size ) const;
+
+  static bool littleEndian();
+  static void swap( char * data, uint32_t elementSize, uint64_t count );
+  static void swapHeader( char * data );
+  static void swapSections( char * data );
+};
+
+
+#include "ModelImage-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_MODEL_IMAGE_HPP_
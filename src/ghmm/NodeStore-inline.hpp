@@ -0,0 +1,150 @@
+template < typename ITM_TRAITS >
+typename RenumberingNodes<ITM_TRAITS>::node_type
+RenumberingNodes<ITM_TRAITS>::add( graph_type & graph )
+{
+  return boost::add_vertex( graph );
+}
+
+template < typename ITM_TRAITS >
+void
+RenumberingNodes<ITM_TRAITS>::remove( graph_type & graph, node_type n )
+{
+  typedef typename boost::edge_bundle_type<graph_type>::type edge_data_type;
+  typedef std::pair<node_type, node_type> endpoints_type;
+  typedef std::pair<endpoints_type, edge_data_type> detached_type;
+
+  // boost::remove_vertex renumbers set based edge lists by erasing from them
+  // while iterating, so every edge that would need renumbering is detached
+  // before and restored afterwards.
+  std::vector<detached_type> detached;
+  typename boost::graph_traits<graph_type>::edge_iterator e;
+  typename boost::graph_traits<graph_type>::edge_iterator edgeEnd;
+  for ( boost::tie( e, edgeEnd ) = boost::edges( graph ); e != edgeEnd; ++e ) {
+    node_type source = boost::source( *e, graph );
+    node_type target = boost::target( *e, graph );
+    if ( source > n || target > n ) {
+      detached.push_back(
+        detached_type( endpoints_type( source, target ), graph[*e] )
+      );
+    }
+  }
+  typename std::vector<detached_type>::iterator d;
+  for ( d = detached.begin(); d != detached.end(); ++d ) {
+    boost::remove_edge( d->first.first, d->first.second, graph );
+  }
+
+  boost::remove_vertex( n, graph );
+
+  for ( d = detached.begin(); d != detached.end(); ++d ) {
+    renumber( n, d->first.first );
+    renumber( n, d->first.second );
+    boost::add_edge( d->first.first, d->first.second, d->second, graph );
+  }
+}
+
+template < typename ITM_TRAITS >
+bool
+RenumberingNodes<ITM_TRAITS>::live( node_type ) const
+{
+  return true;
+}
+
+template < typename ITM_TRAITS >
+bool
+RenumberingNodes<ITM_TRAITS>::compact( graph_type &, std::vector<node_type> & )
+{
+  return false;
+}
+
+template < typename ITM_TRAITS >
+void
+RenumberingNodes<ITM_TRAITS>::renumber( node_type removed, node_type & n )
+{
+  // vecS shifts down every descriptor above the removed one
+  if ( n == removed ) {
+    n = boost::graph_traits<graph_type>::null_vertex();
+  } else if ( n != boost::graph_traits<graph_type>::null_vertex() && n > removed ) {
+    --n;
+  }
+}
+
+template < typename ITM_TRAITS >
+typename StableNodes<ITM_TRAITS>::node_type
+StableNodes<ITM_TRAITS>::add( graph_type & graph )
+{
+  typedef typename boost::vertex_bundle_type<graph_type>::type node_data_type;
+
+  if ( free_.empty() ) {
+    return boost::add_vertex( graph );
+  }
+  node_type n = free_.back();
+  free_.pop_back();
+  dead_[n] = false;
+  graph[n] = node_data_type();
+  return n;
+}
+
+template < typename ITM_TRAITS >
+void
+StableNodes<ITM_TRAITS>::remove( graph_type &, node_type n )
+{
+  if ( n >= dead_.size() ) {
+    dead_.resize( n + 1, false );
+  }
+  dead_[n] = true;
+  free_.push_back( n );
+}
+
+template < typename ITM_TRAITS >
+bool
+StableNodes<ITM_TRAITS>::live( node_type n ) const
+{
+  return n >= dead_.size() || ! dead_[n];
+}
+
+template < typename ITM_TRAITS >
+bool
+StableNodes<ITM_TRAITS>::compact( graph_type & graph, std::vector<node_type> & moved )
+{
+  if ( free_.empty() ) {
+    return false;
+  }
+
+  // Live nodes are copied in order, so that they keep their relative order
+  graph_type compacted;
+  moved.assign(
+    boost::num_vertices( graph ),
+    boost::graph_traits<graph_type>::null_vertex()
+  );
+  typename boost::graph_traits<graph_type>::vertex_iterator n;
+  typename boost::graph_traits<graph_type>::vertex_iterator nodeEnd;
+  for ( boost::tie( n, nodeEnd ) = boost::vertices( graph ); n != nodeEnd; ++n ) {
+    if ( live( *n ) ) {
+      moved[*n] = boost::add_vertex( graph[*n], compacted );
+    }
+  }
+  typename boost::graph_traits<graph_type>::edge_iterator e;
+  typename boost::graph_traits<graph_type>::edge_iterator edgeEnd;
+  for ( boost::tie( e, edgeEnd ) = boost::edges( graph ); e != edgeEnd; ++e ) {
+    boost::add_edge(
+      moved[boost::source( *e, graph )],
+      moved[boost::target( *e, graph )],
+      graph[*e],
+      compacted
+    );
+  }
+  graph.swap( compacted );
+
+  free_.clear();
+  dead_.clear();
+  return true;
+}
+
+template < typename ITM_TRAITS >
+void
+StableNodes<ITM_TRAITS>::renumber( node_type removed, node_type & n )
+{
+  if ( n == removed ) {
+    n = boost::graph_traits<graph_type>::null_vertex();
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef GHMM_NODE_STORE_HPP_
+#define GHMM_NODE_STORE_HPP_
+
+
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/graph_traits.hpp>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Node store policies decide how the ITM adds and removes graph vertices,
+// and so how long a node descriptor stays valid. Both expect vecS storage,
+// or eigen_vecS, and get nodes whose edges are cleared already.
+
+// Removes every node right away. vecS shifts down every descriptor above
+// the removed one, which costs O(V+E) per removal.
+template < typename ITM_TRAITS >
+class RenumberingNodes
+{
+public:
+  typedef typename ITM_TRAITS::graph_type graph_type;
+  typedef typename ITM_TRAITS::node_type node_type;
+
+  static const bool stable = false;
+
+  node_type add( graph_type & graph );
+  void remove( graph_type & graph, node_type n );
+  bool live( node_type n ) const;
+  // Nothing to do, descriptors are always dense
+  bool compact( graph_type & graph, std::vector<node_type> & moved );
+  // What removing a node does to another descriptor
+  static void renumber( node_type removed, node_type & n );
+};
+
+
+// Leaves removed nodes in the graph as tombstones, without edges, and
+// reuses them for later nodes. Removal is O(degree) and no descriptor
+// changes until compact() drops the tombstones in one O(V+E) pass.
+template < typename ITM_TRAITS >
+class StableNodes
+{
+public:
+  typedef typename ITM_TRAITS::graph_type graph_type;
+  typedef typename ITM_TRAITS::node_type node_type;
+
+  static const bool stable = true;
+
+  node_type add( graph_type & graph );
+  void remove( graph_type & graph, node_type n );
+  bool live( node_type n ) const;
+  // Returns false when there is nothing to compact. Otherwise, moved gets
+  // the new descriptor of every node, null_vertex for tombstones.
+  bool compact( graph_type & graph, std::vector<node_type> & moved );
+  static void renumber( node_type removed, node_type & n );
+private:
+  std::vector<node_type> free_;
+  std::vector<bool>      dead_;
+};
+
+
+#include "NodeStore-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_NODE_STORE_HPP_
@@ -0,0 +1,32 @@
+template < typename T >
+T
+NormalFloors<T>::floor()
+{
+  return std::max( T( 1E-40 ), std::sqrt( std::numeric_limits<T>::min() ) );
+}
+
+template < typename T >
+T
+FlushDenormals<T>::floor()
+{
+  return NormalFloors<T>::floor();
+}
+
+template < typename T >
+FlushDenormals<T>::scope_type::scope_type()
+  : mode_( 0 )
+{
+#if defined( __SSE__ ) || defined( _M_X64 )
+  mode_ = _mm_getcsr();
+  // Flush to zero and denormals are zero
+  _mm_setcsr( mode_ | 0x8040 );
+#endif
+}
+
+template < typename T >
+FlushDenormals<T>::scope_type::~scope_type()
+{
+#if defined( __SSE__ ) || defined( _M_X64 )
+  _mm_setcsr( mode_ );
+#endif
+}
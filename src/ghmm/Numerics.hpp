@@ -0,0 +1,61 @@
+#ifndef GHMM_NUMERICS_HPP_
+#define GHMM_NUMERICS_HPP_
+
+
+#if defined( __SSE__ ) || defined( _M_X64 )
+#include <xmmintrin.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace ghmm
+{
+
+
+// Numerics policies give the floor that keeps probabilities from vanishing,
+// and a scope_type that is instantiated around hot loops to set the
+// floating point environment they run in.
+
+// Floors at 1E-40, or at the square root of the smallest normal number
+// when that is larger. For float, 1E-40 itself is subnormal. The product of
+// two floored values stays normal.
+template < typename T >
+struct NormalFloors
+{
+  static T floor();
+
+  struct scope_type
+  {
+    scope_type() {}
+  };
+};
+
+
+// Same floors, and the loops run with flush to zero and denormals are zero
+// set, so that whatever underflows further costs nothing. Only has an
+// effect with SSE.
+template < typename T >
+struct FlushDenormals
+{
+  static T floor();
+
+  class scope_type
+  {
+  public:
+    scope_type();
+    ~scope_type();
+  private:
+    unsigned int mode_;
+  };
+};
+
+
+#include "Numerics-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_NUMERICS_HPP_
@@ -0,0 +1,213 @@
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::SpecializedGHMM(
+  int observationDimension,
+  int fullDimension,
+  const settings_type & settings
+) : n_( check( observationDimension, fullDimension ) ),
+    fullN_( fullDimension ),
+    ghmm_(
+      embed<full_matrix_type>( settings.fullSigma, n_, fullN_, true ),
+      embed<observation_matrix_type>( settings.observationSigma, n_, n_, false ),
+      embed<goal_matrix_type>( settings.goalSigma, n_, fullN_ - n_, false ),
+      settings.insertionDistance,
+      settings.epsilon,
+      settings.statePrior,
+      settings.transitionPrior
+    ),
+    trajectory_()
+{}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::SpecializedGHMM(
+  int observationDimension,
+  int fullDimension,
+  const ModelImage & image
+) : n_( check( observationDimension, fullDimension ) ),
+    fullN_( fullDimension ),
+    ghmm_( image ),
+    trajectory_()
+{}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+bool
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::fits(
+  int observationDimension,
+  int fullDimension
+)
+{
+  int goalDimension = fullDimension - observationDimension;
+  return    observationDimension >= 1 && observationDimension <= N
+         && goalDimension >= 1 && goalDimension <= FULL_N - N;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+int
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::observationDimension() const
+{
+  return n_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+int
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::fullDimension() const
+{
+  return fullN_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::learn( const trajectory_type & trajectory )
+{
+  assert( trajectory.cols() == fullN_ );
+  trajectory_.resize( trajectory.rows() );
+  for ( uint32_t t = 0; t < trajectory_.size(); ++t ) {
+    full_observation_type & o = trajectory_[t];
+    o.setZero();
+    for ( int i = 0; i < fullN_; ++i ) {
+      o[fullIndex( n_, i )] = trajectory( t, i );
+    }
+  }
+  ghmm_.learn( trajectory_.begin(), trajectory_.end() );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::save( const std::string & path ) const
+{
+  ghmm_.save( path );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::initTrack( track_type & track ) const
+{
+  ghmm_.initTrack( track );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::update(
+  track_type & track,
+  const vector_type & o
+) const
+{
+  ghmm_.update( track, observation( o ) );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::predict(
+  track_type & track,
+  uint8_t horizon
+) const
+{
+  ghmm_.predict( track, horizon );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::observationPdf(
+  const track_type & track,
+  uint32_t t,
+  const vector_type & o
+) const
+{
+  return ghmm_.observationPdf( track, t, observation( o ) );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::value_type
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::goalPdf(
+  const track_type & track,
+  const vector_type & g
+) const
+{
+  return ghmm_.goalPdf( track, goal( g ) );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint32_t
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::nodeCount() const
+{
+  return ghmm_.model().nodeCount();
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint32_t
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::edgeCount() const
+{
+  return ghmm_.model().edgeCount();
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+const typename SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::ghmm_type &
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::ghmm() const
+{
+  return ghmm_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+int
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::check(
+  int observationDimension,
+  int fullDimension
+)
+{
+  if ( ! fits( observationDimension, fullDimension ) ) {
+    throw std::invalid_argument( "Dimensions do not fit the specialization" );
+  }
+  return observationDimension;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+int
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::fullIndex( int n, int i )
+{
+  return i < n ? i : N + i - n;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+template < typename MATRIX >
+MATRIX
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::embed(
+  const matrix_type & sigma,
+  int n,
+  int size,
+  bool full
+)
+{
+  if ( sigma.rows() != size || sigma.cols() != size ) {
+    throw std::invalid_argument( "Covariance does not match the dimensions" );
+  }
+  MATRIX result = MATRIX::Identity();
+  for ( int i = 0; i < size; ++i ) {
+    for ( int j = 0; j < size; ++j ) {
+      if ( full ) {
+        result( fullIndex( n, i ), fullIndex( n, j ) ) = sigma( i, j );
+      } else {
+        result( i, j ) = sigma( i, j );
+      }
+    }
+  }
+  return result;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::observation_type
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::observation( const vector_type & o ) const
+{
+  assert( o.size() == n_ );
+  observation_type result = observation_type::Zero();
+  result.head( n_ ) = o;
+  return result;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::goal_type
+SpecializedGHMM<T, N, FULL_N, GHMM_TRAITS>::goal( const vector_type & g ) const
+{
+  assert( g.size() == fullN_ - n_ );
+  goal_type result = goal_type::Zero();
+  result.head( fullN_ - n_ ) = g;
+  return result;
+}
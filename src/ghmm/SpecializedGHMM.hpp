@@ -0,0 +1,96 @@
+#ifndef GHMM_SPECIALIZED_GHMM_HPP_
+#define GHMM_SPECIALIZED_GHMM_HPP_
+
+
+#include "AnyGHMM.hpp"
+#include "GHMM.hpp"
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+
+namespace ghmm
+{
+
+
+// A GHMM of fixed dimensions behind the AnyGHMM interface. Models of fewer
+// dimensions than N and FULL_N - N are embedded: their observations fill
+// the first dimensions of the observation and goal parts, the rest are
+// zero, with unit variance and no correlation.
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS = GHMMDefaultTraits< T, N, FULL_N > >
+class SpecializedGHMM : public AnyGHMM<T>::model_type
+{
+public:
+  typedef AnyGHMM<T> any_type;
+  typedef GHMM<T, N, FULL_N, GHMM_TRAITS> ghmm_type;
+  typedef typename any_type::value_type value_type;
+  typedef typename any_type::vector_type vector_type;
+  typedef typename any_type::matrix_type matrix_type;
+  typedef typename any_type::trajectory_type trajectory_type;
+  typedef typename any_type::track_type track_type;
+  typedef typename any_type::settings_type settings_type;
+
+  // Throw std::invalid_argument when the dimensions do not fit
+  SpecializedGHMM(
+    int observationDimension,
+    int fullDimension,
+    const settings_type & settings
+  );
+  SpecializedGHMM(
+    int observationDimension,
+    int fullDimension,
+    const ModelImage & image
+  );
+
+  static bool fits( int observationDimension, int fullDimension );
+
+  int observationDimension() const;
+  int fullDimension() const;
+  void learn( const trajectory_type & trajectory );
+  void save( const std::string & path ) const;
+  void initTrack( track_type & track ) const;
+  void update( track_type & track, const vector_type & o ) const;
+  void predict( track_type & track, uint8_t horizon ) const;
+  value_type observationPdf(
+    const track_type & track,
+    uint32_t t,
+    const vector_type & o
+  ) const;
+  value_type goalPdf( const track_type & track, const vector_type & g ) const;
+  uint32_t nodeCount() const;
+  uint32_t edgeCount() const;
+
+  const ghmm_type & ghmm() const;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+private:
+  typedef typename ghmm_type::full_observation_type full_observation_type;
+  typedef typename ghmm_type::observation_type observation_type;
+  typedef typename ghmm_type::goal_type goal_type;
+  typedef typename ghmm_type::full_matrix_type full_matrix_type;
+  typedef typename ghmm_type::observation_matrix_type observation_matrix_type;
+  typedef typename ghmm_type::goal_matrix_type goal_matrix_type;
+
+  int n_;
+  int fullN_;
+  ghmm_type ghmm_;
+  // Kept between calls to learn
+  typename ghmm_type::trajectory_type trajectory_;
+
+  static int check( int observationDimension, int fullDimension );
+  // Where dimension i of a full observation of the model goes
+  static int fullIndex( int n, int i );
+  template < typename MATRIX >
+  static MATRIX embed( const matrix_type & sigma, int n, int size, bool full );
+
+  observation_type observation( const vector_type & o ) const;
+  goal_type goal( const vector_type & g ) const;
+};
+
+
+#include "SpecializedGHMM-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_SPECIALIZED_GHMM_HPP_
@@ -0,0 +1,115 @@
+inline
+MetricsTrace::MetricsTrace()
+{
+  reset();
+}
+
+inline
+void
+MetricsTrace::count( trace_counter counter, uint64_t n )
+{
+  counters_[counter] += n;
+}
+
+inline
+void
+MetricsTrace::size( uint32_t nodes, uint32_t edges )
+{
+  nodeCount_ = nodes;
+  edgeCount_ = edges;
+}
+
+inline
+void
+MetricsTrace::start( trace_timer timer )
+{
+  starts_[timer] = now();
+}
+
+inline
+void
+MetricsTrace::stop( trace_timer timer )
+{
+  double elapsed = now() - starts_[timer];
+  ++calls_[timer];
+  seconds_[timer] += elapsed;
+  maxSeconds_[timer] = std::max( maxSeconds_[timer], elapsed );
+}
+
+inline
+uint64_t
+MetricsTrace::counter( trace_counter counter ) const
+{
+  return counters_[counter];
+}
+
+inline
+uint32_t
+MetricsTrace::nodeCount() const
+{
+  return nodeCount_;
+}
+
+inline
+uint32_t
+MetricsTrace::edgeCount() const
+{
+  return edgeCount_;
+}
+
+inline
+uint64_t
+MetricsTrace::calls( trace_timer timer ) const
+{
+  return calls_[timer];
+}
+
+inline
+double
+MetricsTrace::seconds( trace_timer timer ) const
+{
+  return seconds_[timer];
+}
+
+inline
+double
+MetricsTrace::maxSeconds( trace_timer timer ) const
+{
+  return maxSeconds_[timer];
+}
+
+inline
+void
+MetricsTrace::reset()
+{
+  std::fill( counters_, counters_ + TRACE_COUNTER_COUNT, 0 );
+  nodeCount_ = 0;
+  edgeCount_ = 0;
+  std::fill( starts_, starts_ + TRACE_TIMER_COUNT, 0 );
+  std::fill( calls_, calls_ + TRACE_TIMER_COUNT, 0 );
+  std::fill( seconds_, seconds_ + TRACE_TIMER_COUNT, 0 );
+  std::fill( maxSeconds_, maxSeconds_ + TRACE_TIMER_COUNT, 0 );
+}
+
+inline
+double
+MetricsTrace::now()
+{
+  timespec time;
+  clock_gettime( CLOCK_MONOTONIC, &time );
+  return time.tv_sec + time.tv_nsec * 1E-9;
+}
+
+template < typename TRACE >
+TraceScope<TRACE>::TraceScope( TRACE & trace, trace_timer timer )
+  : trace_( trace ),
+    timer_( timer )
+{
+  trace_.start( timer_ );
+}
+
+template < typename TRACE >
+TraceScope<TRACE>::~TraceScope()
+{
+  trace_.stop( timer_ );
+}
@@ -0,0 +1,101 @@
+#ifndef GHMM_TRACE_HPP_
+#define GHMM_TRACE_HPP_
+
+
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+
+
+namespace ghmm
+{
+
+
+// What a trace policy is told about. Counters count changes to the graph,
+// timers time the phases of learning and tracking.
+enum trace_counter {
+  NODES_ADDED,
+  NODES_REMOVED,
+  EDGES_ADDED,
+  EDGES_REMOVED,
+  TRACE_COUNTER_COUNT
+};
+
+enum trace_timer {
+  LEARN_ITM,
+  LEARN_NORMALIZE,
+  LEARN_EXPECTATION,
+  LEARN_MAXIMIZATION,
+  LEARN_COMPILE,
+  TRACK_UPDATE,
+  TRACK_PREDICT,
+  TRACE_TIMER_COUNT
+};
+
+
+// Default trace policy, every call compiles to nothing. Other policies
+// provide the same members.
+struct NullTrace
+{
+  void count( trace_counter, uint64_t = 1 ) {}
+  // Size of the graph after it changed
+  void size( uint32_t, uint32_t ) {}
+  void start( trace_timer ) {}
+  void stop( trace_timer ) {}
+};
+
+
+// Keeps every counter, the last size of the graph and, for every timer, how
+// many times it ran and for how long in total and at most. Not thread safe,
+// learning only records from one thread. Tracking records nothing, callers
+// time it with a TraceScope on a trace of their own, one per thread.
+class MetricsTrace
+{
+public:
+  MetricsTrace();
+
+  void count( trace_counter counter, uint64_t n = 1 );
+  void size( uint32_t nodes, uint32_t edges );
+  void start( trace_timer timer );
+  void stop( trace_timer timer );
+
+  uint64_t counter( trace_counter counter ) const;
+  uint32_t nodeCount() const;
+  uint32_t edgeCount() const;
+  uint64_t calls( trace_timer timer ) const;
+  double seconds( trace_timer timer ) const;
+  double maxSeconds( trace_timer timer ) const;
+  void reset();
+private:
+  uint64_t counters_[TRACE_COUNTER_COUNT];
+  uint32_t nodeCount_;
+  uint32_t edgeCount_;
+  double   starts_[TRACE_TIMER_COUNT];
+  uint64_t calls_[TRACE_TIMER_COUNT];
+  double   seconds_[TRACE_TIMER_COUNT];
+  double   maxSeconds_[TRACE_TIMER_COUNT];
+
+  static double now();
+};
+
+
+// Times the scope it lives in
+template < typename TRACE >
+class TraceScope
+{
+public:
+  TraceScope( TRACE & trace, trace_timer timer );
+  ~TraceScope();
+private:
+  TRACE &     trace_;
+  trace_timer timer_;
+};
+
+
+#include "Trace-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_TRACE_HPP_
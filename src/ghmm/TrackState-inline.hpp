@@ -0,0 +1,28 @@
+template < typename T >
+TrackState<T>::TrackState()
+  : nodeCount( 0 ),
+    estimations(),
+    likelihoods(),
+    nodes()
+{}
+
+template < typename T >
+typename TrackState<T>::value_type
+TrackState<T>::belief( uint32_t n ) const
+{
+  return estimations[n];
+}
+
+template < typename T >
+typename TrackState<T>::value_type
+TrackState<T>::estimation( uint32_t t, uint32_t n ) const
+{
+  return estimations[t * nodeCount + n];
+}
+
+template < typename T >
+uint32_t
+TrackState<T>::horizon() const
+{
+  return nodeCount == 0 ? 0 : estimations.size() / nodeCount - 1;
+}
@@ -0,0 +1,42 @@
+#ifndef GHMM_TRACK_STATE_HPP_
+#define GHMM_TRACK_STATE_HPP_
+
+
+#include <stdint.h>
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Belief of a single tracked object, indexed by node. It holds no part of the
+// model, so that many tracks can share one read-only model.
+template < typename T >
+struct TrackState
+{
+  typedef T value_type;
+  typedef typename std::vector< value_type > value_array;
+
+  TrackState();
+
+  uint32_t nodeCount;
+  // Row t holds the estimation t steps ahead, row 0 is the current belief
+  value_array estimations;
+  // Scratch space for the model, so that it does not need mutable state
+  value_array likelihoods;
+  std::vector< uint32_t > nodes;
+
+  value_type belief( uint32_t n ) const;
+  value_type estimation( uint32_t t, uint32_t n ) const;
+  uint32_t horizon() const;
+};
+
+
+#include "TrackState-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_TRACK_STATE_HPP_
@@ -0,0 +1,197 @@
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+const uint32_t TrackerPool<T, N, FULL_N, GHMM_TRAITS>::npos;
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::TrackerPool( const model_type & model )
+  : model_( model ),
+    estimations_( 1, belief_matrix_type( model.nodeCount(), 0 ) ),
+    horizon_( 0 ),
+    likelihoods_(),
+    observations_( 0, N ),
+    observed_(),
+    columns_(),
+    ids_(),
+    freeIds_()
+{}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename TrackerPool<T, N, FULL_N, GHMM_TRAITS>::track_id
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::add()
+{
+  track_id id;
+  if ( freeIds_.empty() ) {
+    id = columns_.size();
+    columns_.push_back( npos );
+  } else {
+    id = freeIds_.back();
+    freeIds_.pop_back();
+  }
+
+  uint32_t k = ids_.size();
+  columns_[id] = k;
+  ids_.push_back( id );
+  resize( k + 1 );
+  model_.initTracks( estimations_[0], k );
+  observations_.row( k ).setZero();
+  observed_[k] = false;
+  return id;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::remove( track_id id )
+{
+  assert( contains( id ) );
+
+  // The last track takes the place of the removed one
+  uint32_t k = columns_[id];
+  uint32_t last = ids_.size() - 1;
+  if ( k != last ) {
+    for ( uint32_t t = 0; t < estimations_.size(); ++t ) {
+      estimations_[t].col( k ) = estimations_[t].col( last );
+    }
+    observations_.row( k ) = observations_.row( last );
+    observed_[k] = observed_[last];
+    ids_[k] = ids_[last];
+    columns_[ids_[k]] = k;
+  }
+  ids_.pop_back();
+  columns_[id] = npos;
+  freeIds_.push_back( id );
+  resize( last );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+bool
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::contains( track_id id ) const
+{
+  return id < columns_.size() && columns_[id] != npos;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint32_t
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::trackCount() const
+{
+  return ids_.size();
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::observe( 
+  track_id id, 
+  const observation_type & o 
+)
+{
+  assert( contains( id ) );
+  observations_.row( columns_[id] ) = o;
+  observed_[columns_[id]] = true;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::update()
+{
+  typename model_type::numerics_type::scope_type numerics;
+  if ( ids_.empty() ) {
+    return;
+  }
+  // Row 1 is only scratch space here, estimations are stale after an update
+  reserve( 1 );
+  horizon_ = 0;
+
+  model_.observationProbabilities( observations_, likelihoods_ );
+  for ( uint32_t k = 0; k < ids_.size(); ++k ) {
+    if ( ! observed_[k] ) {
+      likelihoods_.col( k ).setOnes();
+    }
+    observed_[k] = false;
+  }
+
+  belief_matrix_type & belief = estimations_[0];
+  belief_matrix_type & next = estimations_[1];
+  model_.transition( belief, next );
+  belief = next.cwiseProduct( likelihoods_ ).cwiseMax( model_type::numerics_type::floor() );
+
+  for ( uint32_t k = 0; k < ids_.size(); ++k ) {
+    value_type total = belief.col( k ).sum();
+    assert( total == total );
+    assert( total > 0 );
+    belief.col( k ) /= total;
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::predict( uint8_t horizon )
+{
+  typename model_type::numerics_type::scope_type numerics;
+  reserve( horizon );
+  horizon_ = horizon;
+  for ( uint32_t t = 1; t <= horizon; ++t ) {
+    model_.transition( estimations_[t - 1], estimations_[t] );
+  }
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename TrackerPool<T, N, FULL_N, GHMM_TRAITS>::value_type
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::belief( track_id id, uint32_t n ) const
+{
+  return estimations_[0]( n, column( id ) );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+typename TrackerPool<T, N, FULL_N, GHMM_TRAITS>::value_type
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::estimation( 
+  track_id id, 
+  uint32_t t, 
+  uint32_t n 
+) const
+{
+  assert( t <= horizon_ );
+  return estimations_[t]( n, column( id ) );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint32_t
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::horizon() const
+{
+  return horizon_;
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+uint32_t
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::column( track_id id ) const
+{
+  assert( contains( id ) );
+  return columns_[id];
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+const typename TrackerPool<T, N, FULL_N, GHMM_TRAITS>::belief_matrix_type &
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::beliefs() const
+{
+  return estimations_[0];
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::resize( uint32_t tracks )
+{
+  for ( uint32_t t = 0; t < estimations_.size(); ++t ) {
+    estimations_[t].conservativeResize( Eigen::NoChange, tracks );
+  }
+  observations_.conservativeResize( tracks, Eigen::NoChange );
+  observed_.resize( tracks );
+}
+
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS >
+void
+TrackerPool<T, N, FULL_N, GHMM_TRAITS>::reserve( uint32_t horizon )
+{
+  if ( estimations_.size() < horizon + 1 ) {
+    estimations_.resize(
+      horizon + 1, 
+      belief_matrix_type( model_.nodeCount(), ids_.size() ) 
+    );
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef GHMM_TRACKER_POOL_HPP_
+#define GHMM_TRACKER_POOL_HPP_
+
+
+#include "CompiledGHMM.hpp"
+#include <vector>
+
+
+namespace ghmm
+{
+
+
+// Filters many tracks at once against one compiled model. Beliefs are stored
+// as a node by track matrix, so that every step is a single sparse times dense
+// product and emissions are evaluated for all tracks in one pass. Tracks keep
+// their id while others are added and removed. The model must outlive the
+// pool.
+template < typename T, int N, int FULL_N,  typename GHMM_TRAITS = GHMMDefaultTraits< T, N, FULL_N > >
+class TrackerPool
+{
+public:
+  typedef CompiledGHMM<T, N, FULL_N, GHMM_TRAITS> model_type;
+  typedef typename model_type::observation_type observation_type;
+  typedef typename model_type::value_type value_type;
+  typedef typename model_type::belief_matrix_type belief_matrix_type;
+  typedef typename model_type::observation_batch_type observation_batch_type;
+  typedef uint32_t track_id;
+
+  TrackerPool( const model_type & model );
+
+  track_id add();
+  void remove( track_id id );
+  bool contains( track_id id ) const;
+  uint32_t trackCount() const;
+
+  // Sets the observation of a track for the next update. Tracks without one
+  // are only propagated through the transitions.
+  void observe( track_id id, const observation_type & o );
+  void update();
+  // Estimations of tracks added since are only valid after the next predict
+  void predict( uint8_t horizon );
+
+  value_type belief( track_id id, uint32_t n ) const;
+  value_type estimation( track_id id, uint32_t t, uint32_t n ) const;
+  uint32_t horizon() const;
+  uint32_t column( track_id id ) const;
+  const belief_matrix_type & beliefs() const;
+private:
+  typedef typename std::vector< uint32_t > index_array;
+
+  const model_type & model_;
+  // Row 0 holds the current beliefs, row t the estimations t steps ahead.
+  // Rows past horizon_ are kept allocated, for later updates and predicts.
+  std::vector< belief_matrix_type > estimations_;
+  uint32_t horizon_;
+  belief_matrix_type likelihoods_;
+  observation_batch_type observations_;
+  std::vector< bool > observed_;
+  index_array columns_;
+  index_array ids_;
+  index_array freeIds_;
+
+  static const uint32_t npos = uint32_t( -1 );
+
+  void resize( uint32_t tracks );
+  // Allocates the rows up to horizon, rows are never freed
+  void reserve( uint32_t horizon );
+};
+
+
+#include "TrackerPool-inline.hpp"
+
+
+}
+
+
+#endif //GHMM_TRACKER_POOL_HPP_
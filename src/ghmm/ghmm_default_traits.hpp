@@ -2,26 +2,24 @@
 #define GHMM_GHMM_DEFAULT_TRAITS_HPP_
 
 
-#ifndef EIGEN_DONT_VECTORIZE
-#define EIGEN_DONT_VECTORIZE
-#endif
-
-#ifndef EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
-#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
-#endif
-
-
 #include <ghmm/ITM.hpp>
 #include <ghmm/itm_eigen_traits.hpp>
+#include <ghmm/LinearIndex.hpp>
+#include <ghmm/GridIndex.hpp>
 #include <ghmm/Mahalanobis.hpp>
+#include <ghmm/Metric.hpp>
+#include <ghmm/NodeStore.hpp>
+#include <ghmm/Numerics.hpp>
 #include <ghmm/Gaussian.hpp>
+#include <ghmm/Trace.hpp>
 #include <eigen3/Eigen/Core>
 #include <eigen3/Eigen/Dense>
 #include <boost/graph/adjacency_list.hpp>
 #include <vector>
 
 
-//TODO: get this to work
+// Vertex storage like vecS, with the alignment fixed size Eigen members
+// need to be vectorized
 namespace boost
 {
   struct eigen_vecS{};
@@ -31,6 +29,16 @@ namespace boost
   {
     typedef std::vector< T, Eigen::aligned_allocator< T > > type;
   };
+
+  namespace detail
+  {
+    template <>
+    struct is_random_access< eigen_vecS >
+    {
+      enum { value = true };
+      typedef mpl::true_ type;
+    };
+  }
 }
 
 
@@ -38,7 +46,16 @@ namespace ghmm
 {
 
 
-template < typename T, int N, int FULL_N>
+template < 
+  typename T, 
+  int N, 
+  int FULL_N, 
+  template < typename > class INDEX = LinearIndex,
+  typename TRACE = NullTrace,
+  template < typename > class NODES = RenumberingNodes,
+  template < typename > class NUMERICS = NormalFloors,
+  template < typename > class METRIC = MahalanobisMetric
+>
 class GHMMDefaultTraits
 {
 public:
@@ -52,19 +69,17 @@ public:
   typedef typename std::vector< value_type > estimations_type;
 
   struct node_data_type {
-    node_data_type() : probability( 0 ){};
+    node_data_type() : probability( 0 ), probabilitySum( 0 ){};
     full_observation_type centroid;
     value_type probability;
     value_type probabilitySum;
     estimations_type estimations;
     value_type belief;
-    std::vector<value_type> alpha;
-    std::vector<value_type> beta;
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   };
 
   struct edge_data_type {
-    edge_data_type() : probability( 0 ){};
+    edge_data_type() : probability( 0 ), numeratorSum( 0 ), denominatorSum( 0 ){};
     value_type probability;
     value_type numeratorSum;
     value_type denominatorSum;
@@ -72,14 +87,20 @@ public:
 
   typedef typename boost::adjacency_list< 
       boost::hash_setS, 
-      boost::vecS, 
+      boost::eigen_vecS, 
       boost::bidirectionalS, 
       node_data_type, 
       edge_data_type > graph_type;
   typedef typename ghmm::itm_eigen_traits< 
       graph_type, 
       value_type, 
-      FULL_N > itm_traits;
+      FULL_N,
+      INDEX,
+      TRACE,
+      NODES,
+      METRIC > itm_traits;
+  typedef TRACE trace_type;
+  typedef NUMERICS< value_type > numerics_type;
   typedef typename ghmm::ITM< itm_traits > itm_type;
   typedef typename ghmm::Mahalanobis<
       value_type, 
@@ -102,7 +123,7 @@ public:
     return o.block( 0, 0, 1, N );
   }
 
-  static observation_type toGoal( const full_observation_type & o )
+  static goal_type toGoal( const full_observation_type & o )
   {
     return o.block( 0, N, 1, FULL_N - N );
   }
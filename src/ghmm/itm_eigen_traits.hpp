@@ -2,16 +2,11 @@
 #define GHMM_ITM_EIGEN_TRAITS_H_
 
 
-#ifndef EIGEN_DONT_VECTORIZE
-#define EIGEN_DONT_VECTORIZE
-#endif
-
-#ifndef EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
-#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
-#endif
-
-
 #include "Mahalanobis.hpp"
+#include "Metric.hpp"
+#include "LinearIndex.hpp"
+#include "NodeStore.hpp"
+#include "Trace.hpp"
 #include <eigen3/Eigen/Core>
 #include <boost/graph/graph_traits.hpp>
 
@@ -20,7 +15,15 @@ namespace ghmm
 {
 
 
-template < typename G, typename T, int N >
+template < 
+  typename G, 
+  typename T, 
+  int N, 
+  template < typename > class INDEX = LinearIndex,
+  typename TRACE = NullTrace,
+  template < typename > class NODES = RenumberingNodes,
+  template < typename > class METRIC = MahalanobisMetric
+>
 class itm_eigen_traits
 {
 public:
@@ -34,6 +37,10 @@ public:
   typedef typename boost::graph_traits<graph_type>::edge_descriptor edge_type;
   typedef typename boost::graph_traits<graph_type>::out_edge_iterator out_edge_iterator;
   typedef typename boost::graph_traits<graph_type>::in_edge_iterator in_edge_iterator;
+  typedef METRIC< itm_eigen_traits > metric_type;
+  typedef INDEX< itm_eigen_traits > index_type;
+  typedef NODES< itm_eigen_traits > node_store_type;
+  typedef TRACE trace_type;
 };
 
 
@@ -1,13 +1,13 @@
-#ifndef EIGEN_DONT_VECTORIZE
-#define EIGEN_DONT_VECTORIZE 1
-#endif
-
-#ifndef EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
-#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT 1
-#endif
-
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <limits>
 #include <iostream>
+#include <ghmm/AnyGHMM.hpp>
 #include <ghmm/GHMM.hpp>
+#include <ghmm/ModelHandle.hpp>
+#include <ghmm/SpecializedGHMM.hpp>
+#include <ghmm/TrackerPool.hpp>
 #include <unittest++/UnitTest++.h>
 
 using namespace boost;
@@ -17,6 +17,29 @@ SUITE( GHMM ) {
 
   //----------------------------------------------------------------------------
 
+  // Covariances of the lanes most tests learn, positions with unit variance
+  // and goals with four
+  template < typename GHMMType >
+  struct Sigmas
+  {
+    Sigmas()
+    {
+      observation << 1.0, 0.0, 
+                     0.0, 1.0;
+      goal << 4.0, 0.0,
+              0.0, 4.0;
+      full << 1.0, 0.0, 0.0, 0.0,
+              0.0, 1.0, 0.0, 0.0,
+              0.0, 0.0, 4.0, 0.0,
+              0.0, 0.0, 0.0, 4.0;
+    }
+    typename GHMMType::observation_matrix_type observation;
+    typename GHMMType::goal_matrix_type goal;
+    typename GHMMType::full_matrix_type full;
+  };
+
+  //----------------------------------------------------------------------------
+
   TEST( Defaults )
   {
     typedef ghmm::GHMM<float, 2, 4> GHMMType;
@@ -40,7 +63,7 @@ SUITE( GHMM ) {
     );
 
     for ( int i = 0; i < 100; ++i ) {
-      std::vector< GHMMType::full_observation_type, Eigen::aligned_allocator<GHMMType::full_observation_type> > trajectory;
+      GHMMType::trajectory_type trajectory;
       for ( int j = 0; j < 100; ++j ) {
         GHMMType::full_observation_type o;
         o << j / 10.0, i / 10.0, i / 100.0, j / 100.0;
@@ -73,7 +96,7 @@ SUITE( GHMM ) {
     );
 
     for ( int i = 0; i < 1; ++i ) {
-      std::vector< GHMMType::full_observation_type> trajectory;
+      GHMMType::trajectory_type trajectory;
       for ( int j = 0; j < 100; ++j ) {
         GHMMType::full_observation_type o;
         o << j / 10.0, i / 10.0, i / 100.0, j / 100.0;
@@ -95,5 +118,1590 @@ SUITE( GHMM ) {
       ghmm.goalPdf( g2, goal );
     }
   }
-}
 
+  TEST( Compiled )
+  {
+    typedef ghmm::GHMM<float, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    for ( int i = 0; i < 3; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 10.0, i / 2.0, i / 100.0, j / 100.0;
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+
+    GHMMType::compiled_type compiled = ghmm.compile();
+    CHECK_EQUAL( boost::num_vertices( ghmm.graph() ), compiled.nodeCount() );
+    CHECK_EQUAL( boost::num_edges( ghmm.graph() ), compiled.edgeCount() );
+
+    GHMMType::graph_type g2;
+    GHMMType::compiled_type::track_type track;
+    ghmm.initTrack( g2 );
+    compiled.initTrack( track );
+
+    for ( int i = 0; i < 20; ++i ) {
+      GHMMType::observation_type o;
+      GHMMType::goal_type goal;
+      o << i / 4.0, 0.5;
+      goal << 0.0, 0.5;
+      ghmm.update( g2, o );
+      compiled.update( track, o );
+      ghmm.predict( g2, 5 );
+      compiled.predict( track, 5 );
+
+      for ( uint32_t t = 0; t <= 5; ++t ) {
+        for ( uint32_t n = 0; n < compiled.nodeCount(); ++n ) {
+          CHECK_CLOSE( g2[n].estimations[t], track.estimation( t, n ), 1E-5 );
+        }
+      }
+      CHECK_CLOSE( 1, 
+        compiled.observationPdf( track, 5, o ) / ghmm.observationPdf( g2, 5, o ), 
+        1E-4 
+      );
+      CHECK_CLOSE( 1, 
+        compiled.goalPdf( track, goal ) / ghmm.goalPdf( g2, goal ), 
+        1E-4 
+      );
+    }
+  }
+
+  TEST( TrackState )
+  {
+    typedef ghmm::GHMM<float, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    GHMMType::trajectory_type trajectory;
+    for ( int j = 0; j < 50; ++j ) {
+      GHMMType::full_observation_type o;
+      o << j / 10.0, 0.0, 0.0, j / 100.0;
+      trajectory.push_back( o );
+    }
+    ghmm.learn( trajectory.begin(), trajectory.end() );
+
+    uint32_t nodeCount = boost::num_vertices( ghmm.graph() );
+
+    GHMMType::graph_type g2;
+    GHMMType::track_type track;
+    ghmm.initTrack( g2 );
+    ghmm.initTrack( track );
+    CHECK_EQUAL( nodeCount, track.nodeCount );
+    CHECK_EQUAL( nodeCount, track.estimations.size() );
+
+    for ( int i = 0; i < 20; ++i ) {
+      GHMMType::observation_type o;
+      o << i / 4.0, 0.0;
+      ghmm.update( g2, o );
+      ghmm.update( track, o );
+      CHECK_EQUAL( 0u, track.horizon() );
+      ghmm.predict( g2, 3 );
+      ghmm.predict( track, 3 );
+      CHECK_EQUAL( 3u, track.horizon() );
+
+      for ( uint32_t n = 0; n < nodeCount; ++n ) {
+        CHECK_CLOSE( g2[n].belief, track.belief( n ), 1E-5 );
+        CHECK_CLOSE( g2[n].estimations[3], track.estimation( 3, n ), 1E-5 );
+      }
+    }
+  }
+
+  TEST( TrackerPool )
+  {
+    typedef ghmm::GHMM<float, 2, 4> GHMMType;
+    typedef ghmm::TrackerPool<float, 2, 4> PoolType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    for ( int i = 0; i < 3; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 10.0, i, i, j / 100.0;
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+
+    GHMMType::compiled_type compiled = ghmm.compile();
+    PoolType pool( compiled );
+    std::vector< GHMMType::track_type > tracks( 3 );
+    std::vector< PoolType::track_id > ids;
+    for ( int i = 0; i < 3; ++i ) {
+      ids.push_back( pool.add() );
+      compiled.initTrack( tracks[i] );
+    }
+    CHECK_EQUAL( 3u, pool.trackCount() );
+
+    for ( int j = 0; j < 20; ++j ) {
+      if ( j == 10 ) {
+        // The last track moves into the freed column and keeps its id
+        pool.remove( ids[1] );
+        CHECK( ! pool.contains( ids[1] ) );
+        CHECK_EQUAL( 2u, pool.trackCount() );
+        CHECK_EQUAL( 1u, pool.column( ids[2] ) );
+        ids[1] = pool.add();
+        compiled.initTrack( tracks[1] );
+        CHECK_EQUAL( 2u, pool.column( ids[1] ) );
+      }
+      for ( int i = 0; i < 3; ++i ) {
+        GHMMType::observation_type o;
+        o << j / 4.0, i;
+        pool.observe( ids[i], o );
+        compiled.update( tracks[i], o );
+        compiled.predict( tracks[i], 3 );
+      }
+      pool.update();
+      pool.predict( 3 );
+      CHECK_EQUAL( 3u, pool.horizon() );
+
+      for ( int i = 0; i < 3; ++i ) {
+        for ( uint32_t n = 0; n < compiled.nodeCount(); ++n ) {
+          CHECK_CLOSE( tracks[i].belief( n ), pool.belief( ids[i], n ), 1E-5 );
+          CHECK_CLOSE( 
+            tracks[i].estimation( 3, n ), 
+            pool.estimation( ids[i], 3, n ), 
+            1E-5 
+          );
+        }
+      }
+    }
+
+    // Without an observation the belief is only propagated
+    PoolType::belief_matrix_type expected;
+    compiled.transition( pool.beliefs(), expected );
+    pool.update();
+    for ( int i = 0; i < 3; ++i ) {
+      float total = expected.col( pool.column( ids[i] ) ).sum();
+      for ( uint32_t n = 0; n < compiled.nodeCount(); ++n ) {
+        CHECK_CLOSE( 
+          expected( n, pool.column( ids[i] ) ) / total, 
+          pool.belief( ids[i], n ), 
+          1E-5 
+        );
+      }
+    }
+  }
+
+  TEST( LearnBatch )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+
+    typedef GHMMType::trajectory_type trajectory_type;
+    std::vector< trajectory_type > trajectories( 7 );
+    for ( int i = 0; i < 7; ++i ) {
+      for ( int j = 0; j < 40; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, i % 3, i % 3, j / 40.0;
+        trajectories[i].push_back( o );
+      }
+    }
+
+    // A batch of one is the same as learning the trajectory alone
+    GHMMType single( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+    GHMMType batch( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+    single.learn( trajectories[0].begin(), trajectories[0].end() );
+    batch.learnBatch( trajectories.begin(), trajectories.begin() + 1 );
+
+    GHMMType::node_iterator n;
+    GHMMType::node_iterator nodeEnd;
+    GHMMType::out_edge_iterator e;
+    GHMMType::out_edge_iterator edgeEnd;
+
+    CHECK_EQUAL( num_vertices( single.graph() ), num_vertices( batch.graph() ) );
+    for ( tie( n, nodeEnd ) = vertices( single.graph() ); n != nodeEnd; ++n ) {
+      CHECK_EQUAL( single.graph()[*n].probability, batch.graph()[*n].probability );
+      for ( tie( e, edgeEnd ) = out_edges( *n, single.graph() ); e != edgeEnd; ++e ) {
+        GHMMType::graph_type::edge_descriptor e2 = 
+          edge( *n, target( *e, single.graph() ), batch.graph() ).first;
+        CHECK_EQUAL( single.graph()[*e].probability, batch.graph()[e2].probability );
+      }
+    }
+
+    // Partitioning only changes the order of the reduction
+    GHMMType serial( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+    GHMMType parallel( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+    serial.learnBatch( trajectories.begin(), trajectories.end(), 1 );
+    parallel.learnBatch( trajectories.begin(), trajectories.end(), 3 );
+
+    CHECK_EQUAL( num_vertices( serial.graph() ), num_vertices( parallel.graph() ) );
+    CHECK_EQUAL( num_edges( serial.graph() ), num_edges( parallel.graph() ) );
+    for ( tie( n, nodeEnd ) = vertices( serial.graph() ); n != nodeEnd; ++n ) {
+      CHECK_CLOSE( serial.graph()[*n].probability, parallel.graph()[*n].probability, 1E-9 );
+      for ( tie( e, edgeEnd ) = out_edges( *n, serial.graph() ); e != edgeEnd; ++e ) {
+        GHMMType::graph_type::edge_descriptor e2 = 
+          edge( *n, target( *e, serial.graph() ), parallel.graph() ).first;
+        CHECK_CLOSE( serial.graph()[*e].probability, parallel.graph()[e2].probability, 1E-9 );
+      }
+    }
+  }
+
+  TEST( GatedUpdate )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    for ( int i = 0; i < 3; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 200; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, 2 * i, 2 * i, 0.0;
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+
+    GHMMType::compiled_type compiled = ghmm.compile();
+    GHMMType::track_type exact;
+    compiled.initTrack( exact );
+
+    for ( int j = 0; j < 40; ++j ) {
+      GHMMType::observation_type o;
+      o << j, 2;
+
+      // A gate containing every node is an exact update
+      GHMMType::track_type wide = exact;
+      CHECK_CLOSE( 0.0, compiled.update( wide, o, 1E6 ), 1E-12 );
+
+      GHMMType::track_type gated = exact;
+      double dropped = compiled.update( gated, o, 9.21 );
+      compiled.update( exact, o );
+
+      double difference = 0;
+      for ( uint32_t n = 0; n < compiled.nodeCount(); ++n ) {
+        CHECK_CLOSE( exact.belief( n ), wide.belief( n ), 1E-9 );
+        difference += std::fabs( exact.belief( n ) - gated.belief( n ) );
+      }
+      CHECK( dropped < 0.05 );
+      CHECK( difference <= 2 * dropped + 1E-9 );
+    }
+
+    // Without any node in the gate the update falls back to the exact one
+    GHMMType::observation_type far;
+    far << 1000, 1000;
+    GHMMType::track_type gated = exact;
+    CHECK_EQUAL( 0.0, compiled.update( gated, far, 9.21 ) );
+    compiled.update( exact, far );
+    for ( uint32_t n = 0; n < compiled.nodeCount(); ++n ) {
+      CHECK_EQUAL( exact.belief( n ), gated.belief( n ) );
+    }
+  }
+
+  TEST( SparsePredict )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    for ( int i = 0; i < 3; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 200; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, 2 * i, 2 * i, 0.0;
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+
+    GHMMType::track_type track;
+    ghmm.initTrack( track );
+    for ( int j = 0; j < 10; ++j ) {
+      GHMMType::observation_type o;
+      o << j / 5.0, 2;
+      ghmm.update( track, o );
+    }
+
+    uint8_t horizon = 50;
+    GHMMType::track_type exact = track;
+    ghmm.predict( exact, horizon );
+
+    // Without a threshold every reachable node is propagated
+    GHMMType::track_type sparse = track;
+    CHECK_CLOSE( 0.0, ghmm.predict( sparse, horizon, 0.0 ), 1E-12 );
+    for ( uint32_t t = 0; t <= horizon; ++t ) {
+      for ( uint32_t n = 0; n < track.nodeCount; ++n ) {
+        CHECK_CLOSE( exact.estimation( t, n ), sparse.estimation( t, n ), 1E-12 );
+      }
+    }
+
+    // Pruned mass is lost, but no estimation is larger than the exact one
+    double pruned = ghmm.predict( sparse, horizon, 1E-6 );
+    CHECK( pruned > 0 );
+    CHECK( pruned < 1E-3 );
+    CHECK_EQUAL( horizon, sparse.horizon() );
+    double total = 0;
+    for ( uint32_t n = 0; n < track.nodeCount; ++n ) {
+      total += sparse.estimation( horizon, n );
+      CHECK( sparse.estimation( horizon, n ) <= exact.estimation( horizon, n ) + 1E-12 );
+    }
+    CHECK_CLOSE( 1.0, total + pruned, 1E-9 );
+  }
+
+  TEST( BatchedPdf )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    typedef GHMMType::compiled_type CompiledType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    for ( int i = 0; i < 3; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, 2 * i, 2 * i, 10.0;
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+
+    GHMMType::track_type track;
+    ghmm.initTrack( track );
+    GHMMType::observation_type o;
+    o << 1, 2;
+    ghmm.update( track, o );
+    ghmm.predict( track, 5 );
+
+    // A 12 x 10 grid of queries
+    CompiledType::observation_batch_type grid( 120, 2 );
+    CompiledType::goal_batch_type goals( 120, 2 );
+    for ( int x = 0; x < 12; ++x ) {
+      for ( int y = 0; y < 10; ++y ) {
+        grid.row( x * 10 + y ) << x, y / 2.0;
+        goals.row( x * 10 + y ) << y / 2.0, x;
+      }
+    }
+    CompiledType::index_array horizons;
+    horizons.push_back( 0 );
+    horizons.push_back( 2 );
+    horizons.push_back( 5 );
+
+    CompiledType::density_matrix_type densities;
+    ghmm.observationPdf( track, horizons, grid, densities );
+    CHECK_EQUAL( 120, densities.rows() );
+    CHECK_EQUAL( 3, densities.cols() );
+    for ( int q = 0; q < 120; ++q ) {
+      for ( uint32_t h = 0; h < horizons.size(); ++h ) {
+        GHMMType::observation_type point = grid.row( q );
+        double expected = ghmm.observationPdf( track, horizons[h], point );
+        CHECK_CLOSE( 1.0, densities( q, h ) / expected, 1E-12 );
+      }
+    }
+
+    ghmm.goalPdf( track, goals, densities );
+    CHECK_EQUAL( 120, densities.rows() );
+    CHECK_EQUAL( 1, densities.cols() );
+    for ( int q = 0; q < 120; ++q ) {
+      GHMMType::goal_type goal = goals.row( q );
+      CHECK_CLOSE( 1.0, densities( q, 0 ) / ghmm.goalPdf( track, goal ), 1E-12 );
+    }
+  }
+
+  TEST( SaveLoad )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    typedef GHMMType::compiled_type CompiledType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    std::vector< GHMMType::trajectory_type > trajectories( 4 );
+    for ( int i = 0; i < 4; ++i ) {
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, i, i, j / 50.0;
+        trajectories[i].push_back( o );
+      }
+    }
+    for ( int i = 0; i < 3; ++i ) {
+      ghmm.learn( trajectories[i].begin(), trajectories[i].end() );
+    }
+
+    const char * path = "TestGHMM.model";
+    ghmm.save( path );
+
+    // Mapped models filter exactly as the one they were written from
+    CompiledType compiled = ghmm.compile();
+    CompiledType mapped = CompiledType::load( path );
+    CHECK_EQUAL( compiled.nodeCount(), mapped.nodeCount() );
+    CHECK_EQUAL( compiled.edgeCount(), mapped.edgeCount() );
+
+    GHMMType::track_type track;
+    GHMMType::track_type mappedTrack;
+    compiled.initTrack( track );
+    mapped.initTrack( mappedTrack );
+    for ( int j = 0; j < 10; ++j ) {
+      GHMMType::observation_type o;
+      o << j / 2.0, 1;
+      compiled.update( track, o );
+      compiled.predict( track, 3 );
+      mapped.update( mappedTrack, o );
+      mapped.predict( mappedTrack, 3 );
+      for ( uint32_t n = 0; n < track.estimations.size(); ++n ) {
+        CHECK_EQUAL( track.estimations[n], mappedTrack.estimations[n] );
+      }
+    }
+
+    // Restored models keep learning like the original
+    GHMMType restored( ghmm::ModelImage::read( path ) );
+    CHECK_EQUAL( num_vertices( ghmm.graph() ), num_vertices( restored.graph() ) );
+    CHECK_EQUAL( num_edges( ghmm.graph() ), num_edges( restored.graph() ) );
+
+    ghmm.learn( trajectories[3].begin(), trajectories[3].end() );
+    restored.learn( trajectories[3].begin(), trajectories[3].end() );
+
+    GHMMType::node_iterator n;
+    GHMMType::node_iterator nodeEnd;
+    GHMMType::out_edge_iterator e;
+    GHMMType::out_edge_iterator edgeEnd;
+
+    CHECK_EQUAL( num_vertices( ghmm.graph() ), num_vertices( restored.graph() ) );
+    CHECK_EQUAL( num_edges( ghmm.graph() ), num_edges( restored.graph() ) );
+    for ( tie( n, nodeEnd ) = vertices( ghmm.graph() ); n != nodeEnd; ++n ) {
+      CHECK_CLOSE( ghmm.graph()[*n].probability, restored.graph()[*n].probability, 1E-9 );
+      for ( tie( e, edgeEnd ) = out_edges( *n, ghmm.graph() ); e != edgeEnd; ++e ) {
+        GHMMType::graph_type::edge_descriptor e2 = 
+          edge( *n, target( *e, ghmm.graph() ), restored.graph() ).first;
+        CHECK_CLOSE( ghmm.graph()[*e].probability, restored.graph()[e2].probability, 1E-9 );
+      }
+    }
+
+    // Files only load into models of the same types
+    CHECK_THROW( ( ghmm::GHMM<float, 2, 4>::compiled_type::load( path ) ), std::runtime_error );
+    ghmm.compile().save( path );
+    CHECK_THROW( GHMMType restored( ghmm::ModelImage::map( path ) ), std::runtime_error );
+
+    std::remove( path );
+  }
+
+  TEST( CorruptedFile )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    typedef GHMMType::compiled_type CompiledType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    for ( int i = 0; i < 2; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, i, i, j / 50.0;
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+
+    const char * path = "TestGHMM.model";
+    const char * corrupted = "TestGHMMCorrupted.model";
+    ghmm.compile().save( path );
+    uint32_t nodeCount = ghmm.model().nodeCount();
+    uint32_t edgeCount = ghmm.model().edgeCount();
+
+    // Offsets that do not rise to the end of their arrays and indices past
+    // the last node are caught on load, before tracking reads through them
+    for ( int i = 0; i < 6; ++i ) {
+      ghmm::ModelImage image = ghmm::ModelImage::read( path );
+      switch ( i ) {
+        case 0:
+          image.section<uint32_t>( ghmm::ModelImage::IN_OFFSETS )[nodeCount] = edgeCount - 1;
+          break;
+        case 1:
+          image.section<uint32_t>( ghmm::ModelImage::OUT_OFFSETS )[1] = edgeCount;
+          break;
+        case 2:
+          image.section<uint32_t>( ghmm::ModelImage::CELL_OFFSETS )[0] = 1;
+          break;
+        case 3:
+          image.section<uint32_t>( ghmm::ModelImage::SOURCES )[edgeCount - 1] = nodeCount;
+          break;
+        case 4:
+          image.section<uint32_t>( ghmm::ModelImage::TARGETS )[0] = nodeCount;
+          break;
+        case 5:
+          image.section<uint32_t>( ghmm::ModelImage::CELL_NODES )[nodeCount - 1] = uint32_t( -1 );
+          break;
+      }
+      image.save( corrupted );
+      CHECK_THROW( CompiledType::load( corrupted ), std::runtime_error );
+    }
+
+    // The file it was corrupted from loads
+    CompiledType mapped = CompiledType::load( path );
+    CHECK_EQUAL( nodeCount, mapped.nodeCount() );
+
+    std::remove( path );
+    std::remove( corrupted );
+  }
+
+  TEST( StreamingLearn )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+
+    std::vector< GHMMType::trajectory_type > trajectories( 4 );
+    for ( int i = 0; i < 4; ++i ) {
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, i, i, j / 50.0;
+        trajectories[i].push_back( o );
+      }
+    }
+
+    GHMMType batch( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+    GHMMType streaming( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+    for ( int i = 0; i < 4; ++i ) {
+      batch.learn( trajectories[i].begin(), trajectories[i].end() );
+    }
+
+    // Two trajectories at a time, observations interleaved
+    for ( int i = 0; i < 4; i += 2 ) {
+      GHMMType::session_id first = streaming.beginTrajectory( 5 );
+      GHMMType::session_id second = streaming.beginTrajectory( 5 );
+      CHECK( first != second );
+      for ( int j = 0; j < 50; ++j ) {
+        streaming.observe( first, trajectories[i][j] );
+        streaming.observe( second, trajectories[i + 1][j] );
+      }
+      streaming.endTrajectory( first );
+      streaming.endTrajectory( second );
+    }
+
+    CHECK_EQUAL( num_vertices( batch.graph() ), num_vertices( streaming.graph() ) );
+
+    GHMMType::node_iterator n;
+    GHMMType::node_iterator nodeEnd;
+    GHMMType::out_edge_iterator e;
+    GHMMType::out_edge_iterator edgeEnd;
+
+    double priorSum = 0;
+    for ( tie( n, nodeEnd ) = vertices( streaming.graph() ); n != nodeEnd; ++n ) {
+      priorSum += streaming.graph()[*n].probability;
+      double transitionSum = 0;
+      for ( tie( e, edgeEnd ) = out_edges( *n, streaming.graph() ); e != edgeEnd; ++e ) {
+        transitionSum += streaming.graph()[*e].probability;
+      }
+      CHECK_CLOSE( 1.0, transitionSum, 1E-9 );
+    }
+    CHECK_CLOSE( 1.0, priorSum, 1E-9 );
+
+    // Both models predict the same goal with similar confidence
+    GHMMType::track_type batchTrack;
+    GHMMType::track_type streamingTrack;
+    batch.initTrack( batchTrack );
+    streaming.initTrack( streamingTrack );
+    GHMMType::goal_type g;
+    g << 1, 1;
+    for ( int j = 0; j < 20; ++j ) {
+      GHMMType::observation_type o;
+      o << j / 5.0, 1;
+      batch.update( batchTrack, o );
+      batch.predict( batchTrack, 5 );
+      streaming.update( streamingTrack, o );
+      streaming.predict( streamingTrack, 5 );
+      CHECK_CLOSE( batch.goalPdf( batchTrack, g ), streaming.goalPdf( streamingTrack, g ), 0.05 );
+    }
+  }
+
+  TEST( StreamingMatchesLearn )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+
+    GHMMType::trajectory_type trajectory;
+    for ( int j = 0; j < 40; ++j ) {
+      GHMMType::full_observation_type o;
+      o << j / 5.0, std::sin( j / 8.0 ), 1, j / 40.0;
+      trajectory.push_back( o );
+    }
+
+    // With a window as long as the trajectory, smoothing sees what learn
+    // sees. Centroids stay put, as emissions in the window are not
+    // recomputed when they move.
+    GHMMType batch( sigma.full, sigma.observation, sigma.goal, 1, 0, 0.001, 0.001 );
+    GHMMType streaming( sigma.full, sigma.observation, sigma.goal, 1, 0, 0.001, 0.001 );
+    batch.learn( trajectory.begin(), trajectory.end() );
+    GHMMType::session_id session = streaming.beginTrajectory( trajectory.size() );
+    for ( uint32_t j = 0; j < trajectory.size(); ++j ) {
+      streaming.observe( session, trajectory[j] );
+    }
+    streaming.endTrajectory( session );
+
+    CHECK_EQUAL( num_vertices( batch.graph() ), num_vertices( streaming.graph() ) );
+    CHECK_EQUAL( num_edges( batch.graph() ), num_edges( streaming.graph() ) );
+
+    GHMMType::node_iterator n;
+    GHMMType::node_iterator nodeEnd;
+    GHMMType::out_edge_iterator e;
+    GHMMType::out_edge_iterator edgeEnd;
+
+    for ( tie( n, nodeEnd ) = vertices( batch.graph() ); n != nodeEnd; ++n ) {
+      CHECK_ARRAY_CLOSE( 
+        batch.graph()[*n].centroid, streaming.graph()[*n].centroid, 4, 1E-12 
+      );
+      CHECK_CLOSE( 
+        batch.graph()[*n].probabilitySum, streaming.graph()[*n].probabilitySum, 1E-9 
+      );
+      for ( tie( e, edgeEnd ) = out_edges( *n, batch.graph() ); e != edgeEnd; ++e ) {
+        GHMMType::graph_type::edge_descriptor e2;
+        bool found;
+        tie( e2, found ) = edge( *n, target( *e, batch.graph() ), streaming.graph() );
+        CHECK( found );
+        if ( found ) {
+          CHECK_CLOSE( batch.graph()[*e].numeratorSum, streaming.graph()[e2].numeratorSum, 1E-9 );
+          CHECK_CLOSE( batch.graph()[*e].denominatorSum, streaming.graph()[e2].denominatorSum, 1E-9 );
+        }
+      }
+    }
+  }
+
+  TEST( CheckpointedLearn )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+
+    // Lengths that are and are not squares, and a single step
+    int lengths[] = { 49, 37, 1, 60 };
+    std::vector< GHMMType::trajectory_type > trajectories( 4 );
+    for ( int i = 0; i < 4; ++i ) {
+      for ( int j = 0; j < lengths[i]; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, i % 2, i % 2, j / 50.0;
+        trajectories[i].push_back( o );
+      }
+    }
+
+    GHMMType full( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+    GHMMType checkpointed( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+    for ( int i = 0; i < 3; ++i ) {
+      full.learn( trajectories[i].begin(), trajectories[i].end() );
+      checkpointed.learn( trajectories[i].begin(), trajectories[i].end(), true );
+    }
+    full.learnBatch( trajectories.begin() + 3, trajectories.end() );
+    checkpointed.learnBatch( trajectories.begin() + 3, trajectories.end(), 0, true );
+
+    GHMMType::node_iterator n;
+    GHMMType::node_iterator nodeEnd;
+    GHMMType::out_edge_iterator e;
+    GHMMType::out_edge_iterator edgeEnd;
+
+    CHECK_EQUAL( num_vertices( full.graph() ), num_vertices( checkpointed.graph() ) );
+    CHECK_EQUAL( num_edges( full.graph() ), num_edges( checkpointed.graph() ) );
+    for ( tie( n, nodeEnd ) = vertices( full.graph() ); n != nodeEnd; ++n ) {
+      CHECK_EQUAL( full.graph()[*n].probability, checkpointed.graph()[*n].probability );
+      CHECK_EQUAL( full.graph()[*n].probabilitySum, checkpointed.graph()[*n].probabilitySum );
+      for ( tie( e, edgeEnd ) = out_edges( *n, full.graph() ); e != edgeEnd; ++e ) {
+        GHMMType::graph_type::edge_descriptor e2 = 
+          edge( *n, target( *e, full.graph() ), checkpointed.graph() ).first;
+        CHECK_EQUAL( full.graph()[*e].probability, checkpointed.graph()[e2].probability );
+        CHECK_EQUAL( full.graph()[*e].numeratorSum, checkpointed.graph()[e2].numeratorSum );
+        CHECK_EQUAL( full.graph()[*e].denominatorSum, checkpointed.graph()[e2].denominatorSum );
+      }
+    }
+  }
+
+  TEST( Trace )
+  {
+    typedef ghmm::GHMMDefaultTraits< 
+      double, 2, 4, ghmm::LinearIndex, ghmm::MetricsTrace 
+    > TraitsType;
+    typedef ghmm::GHMM<double, 2, 4, TraitsType> GHMMType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    std::vector< GHMMType::trajectory_type > trajectories( 3 );
+    for ( int i = 0; i < 3; ++i ) {
+      for ( int j = 0; j < 40; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, i, i, j / 40.0;
+        trajectories[i].push_back( o );
+      }
+    }
+    ghmm.learn( trajectories[0].begin(), trajectories[0].end() );
+    ghmm.learnBatch( trajectories.begin() + 1, trajectories.end() );
+
+    // Counters account for every change to the graph
+    const ghmm::MetricsTrace & trace = ghmm.trace();
+    CHECK_EQUAL( 
+      num_vertices( ghmm.graph() ), 
+      trace.counter( ghmm::NODES_ADDED ) - trace.counter( ghmm::NODES_REMOVED ) 
+    );
+    CHECK_EQUAL( 
+      num_edges( ghmm.graph() ), 
+      trace.counter( ghmm::EDGES_ADDED ) - trace.counter( ghmm::EDGES_REMOVED ) 
+    );
+    CHECK_EQUAL( num_vertices( ghmm.graph() ), trace.nodeCount() );
+    CHECK_EQUAL( num_edges( ghmm.graph() ), trace.edgeCount() );
+
+    CHECK_EQUAL( 2u, trace.calls( ghmm::LEARN_ITM ) );
+    CHECK_EQUAL( 2u, trace.calls( ghmm::LEARN_EXPECTATION ) );
+    CHECK_EQUAL( 2u, trace.calls( ghmm::LEARN_COMPILE ) );
+    CHECK( trace.seconds( ghmm::LEARN_EXPECTATION ) > 0 );
+    CHECK( trace.maxSeconds( ghmm::LEARN_EXPECTATION ) <= trace.seconds( ghmm::LEARN_EXPECTATION ) );
+
+    // Tracking leaves the shared trace alone, callers time it in their own
+    ghmm::MetricsTrace tracking;
+    GHMMType::track_type track;
+    ghmm.initTrack( track );
+    for ( int j = 0; j < 5; ++j ) {
+      GHMMType::observation_type o;
+      o << j / 5.0, 1;
+      {
+        ghmm::TraceScope< ghmm::MetricsTrace > scope( tracking, ghmm::TRACK_UPDATE );
+        ghmm.update( track, o );
+      }
+      ghmm::TraceScope< ghmm::MetricsTrace > scope( tracking, ghmm::TRACK_PREDICT );
+      ghmm.predict( track, 3 );
+    }
+    CHECK_EQUAL( 0u, trace.calls( ghmm::TRACK_UPDATE ) );
+    CHECK_EQUAL( 0u, trace.calls( ghmm::TRACK_PREDICT ) );
+    CHECK_EQUAL( 5u, tracking.calls( ghmm::TRACK_UPDATE ) );
+    CHECK_EQUAL( 5u, tracking.calls( ghmm::TRACK_PREDICT ) );
+
+    ghmm.trace().reset();
+    CHECK_EQUAL( 0u, trace.calls( ghmm::LEARN_ITM ) );
+    CHECK_EQUAL( 0u, trace.counter( ghmm::NODES_ADDED ) );
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( StableNodes )
+  {
+    typedef ghmm::GHMMDefaultTraits< 
+      double, 2, 4, ghmm::LinearIndex, ghmm::MetricsTrace 
+    > RenumberingTraits;
+    typedef ghmm::GHMMDefaultTraits< 
+      double, 2, 4, ghmm::LinearIndex, ghmm::MetricsTrace, ghmm::StableNodes 
+    > StableTraits;
+    typedef ghmm::GHMM<double, 2, 4, RenumberingTraits> RenumberingType;
+    typedef ghmm::GHMM<double, 2, 4, StableTraits> StableType;
+    Sigmas< RenumberingType > sigma;
+    RenumberingType renumbering( sigma.full, sigma.observation, sigma.goal, 1, 0.4, 0.001, 0.001 );
+    StableType stable( sigma.full, sigma.observation, sigma.goal, 1, 0.4, 0.001, 0.001 );
+
+    // Crossing and noisy enough for the ITM to remove nodes
+    std::vector< RenumberingType::trajectory_type > trajectories( 10 );
+    for ( int i = 0; i < 10; ++i ) {
+      for ( int j = 0; j < 60; ++j ) {
+        double a = i * 0.7;
+        double noise = 1.2 * std::sin( 12.9898 * ( i * 60 + j ) );
+        RenumberingType::full_observation_type o;
+        o << j / 6.0 * std::cos( a ) + noise, 
+             j / 6.0 * std::sin( a ) - noise, 
+             std::cos( a ), 
+             std::sin( a );
+        trajectories[i].push_back( o );
+      }
+    }
+    renumbering.learn( trajectories[0].begin(), trajectories[0].end() );
+    stable.learn( trajectories[0].begin(), trajectories[0].end() );
+    renumbering.learnBatch( trajectories.begin() + 1, trajectories.begin() + 5 );
+    stable.learnBatch( trajectories.begin() + 1, trajectories.begin() + 5 );
+
+    // Streaming sessions follow their nodes through compaction
+    for ( int i = 5; i < 10; i += 2 ) {
+      RenumberingType::session_id r1 = renumbering.beginTrajectory( 4 );
+      RenumberingType::session_id r2 = renumbering.beginTrajectory( 4 );
+      StableType::session_id s1 = stable.beginTrajectory( 4 );
+      StableType::session_id s2 = stable.beginTrajectory( 4 );
+      for ( int j = 0; j < 60; ++j ) {
+        renumbering.observe( r1, trajectories[i][j] );
+        stable.observe( s1, trajectories[i][j] );
+        if ( i + 1 < 10 ) {
+          renumbering.observe( r2, trajectories[i + 1][j] );
+          stable.observe( s2, trajectories[i + 1][j] );
+        }
+      }
+      renumbering.endTrajectory( r1 );
+      renumbering.endTrajectory( r2 );
+      stable.endTrajectory( s1 );
+      stable.endTrajectory( s2 );
+    }
+    CHECK( stable.trace().counter( ghmm::NODES_REMOVED ) > 0 );
+    CHECK_EQUAL( 
+      renumbering.trace().counter( ghmm::NODES_REMOVED ), 
+      stable.trace().counter( ghmm::NODES_REMOVED ) 
+    );
+
+    // Same model, nodes may be numbered differently
+    CHECK_EQUAL( num_vertices( renumbering.graph() ), num_vertices( stable.graph() ) );
+    CHECK_EQUAL( num_edges( renumbering.graph() ), num_edges( stable.graph() ) );
+    StableType::node_iterator n;
+    StableType::node_iterator nodeEnd;
+    for ( tie( n, nodeEnd ) = vertices( stable.graph() ); n != nodeEnd; ++n ) {
+      const StableType::full_observation_type & centroid = stable.graph()[*n].centroid;
+      RenumberingType::node_iterator m;
+      RenumberingType::node_iterator mEnd;
+      for ( tie( m, mEnd ) = vertices( renumbering.graph() ); m != mEnd; ++m ) {
+        if ( renumbering.graph()[*m].centroid == centroid ) {
+          break;
+        }
+      }
+      CHECK( m != mEnd );
+      if ( m != mEnd ) {
+        CHECK_CLOSE( 
+          renumbering.graph()[*m].probability, 
+          stable.graph()[*n].probability, 
+          1E-9 
+        );
+        CHECK_EQUAL( out_degree( *m, renumbering.graph() ), out_degree( *n, stable.graph() ) );
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+
+  // Learns three lanes and tracks along the middle one. Expected values come
+  // from a build with EIGEN_DONT_VECTORIZE.
+  template < typename T, int N, int FULL_N >
+  void checkVectorized( 
+    uint32_t nodes, 
+    uint32_t edges, 
+    double mean, 
+    double goalProbability, 
+    double tolerance 
+  )
+  {
+    typedef ghmm::GHMM<T, N, FULL_N> GHMMType;
+    GHMMType ghmm( 
+      GHMMType::full_matrix_type::Identity(), 
+      GHMMType::observation_matrix_type::Identity(), 
+      4 * GHMMType::goal_matrix_type::Identity(), 
+      1, 0.1, 0.001, 0.001 
+    );
+    for ( int i = 0; i < 3; ++i ) {
+      typename GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 30; ++j ) {
+        typename GHMMType::full_observation_type o;
+        o[0] = j / 3.0;
+        for ( int d = 1; d < N; ++d ) {
+          o[d] = i + 0.1 * std::sin( 1.0 * j + d );
+        }
+        for ( int d = N; d < FULL_N; ++d ) {
+          o[d] = i + 0.5 * d;
+        }
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+    CHECK_EQUAL( nodes, num_vertices( ghmm.graph() ) );
+    CHECK_EQUAL( edges, num_edges( ghmm.graph() ) );
+
+    // Prior weighted mean of the first coordinate
+    double sum = 0;
+    typename GHMMType::node_iterator n;
+    typename GHMMType::node_iterator nodeEnd;
+    for ( tie( n, nodeEnd ) = vertices( ghmm.graph() ); n != nodeEnd; ++n ) {
+      sum += ghmm.graph()[*n].probability * ghmm.graph()[*n].centroid[0];
+    }
+    CHECK_CLOSE( mean, sum, tolerance );
+
+    typename GHMMType::track_type track;
+    ghmm.initTrack( track );
+    for ( int j = 0; j < 10; ++j ) {
+      typename GHMMType::observation_type o;
+      o[0] = j / 3.0;
+      for ( int d = 1; d < N; ++d ) {
+        o[d] = 1 + 0.1 * std::sin( 1.0 * j + d );
+      }
+      ghmm.update( track, o );
+    }
+    ghmm.predict( track, 5 );
+    typename GHMMType::goal_type goal;
+    for ( int d = 0; d < FULL_N - N; ++d ) {
+      goal[d] = 1 + 0.5 * ( d + N );
+    }
+    CHECK_CLOSE( goalProbability, ghmm.goalPdf( track, goal ), tolerance );
+  }
+
+  TEST( Vectorized )
+  {
+    checkVectorized<float, 2, 4>( 24, 74, 0.217877227697, 0.964427710, 1E-5 );
+    checkVectorized<double, 4, 6>( 24, 70, 0.280083981333, 0.99995950, 1E-8 );
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( Numerics )
+  {
+    // Double keeps its floor, float gets one whose square is still normal
+    CHECK_EQUAL( 1E-40, ghmm::NormalFloors<double>::floor() );
+    float floor = ghmm::NormalFloors<float>::floor();
+    CHECK( floor * floor >= std::numeric_limits<float>::min() );
+
+    typedef ghmm::GHMM<float, 2, 4> FloatType;
+    typedef ghmm::GHMM<double, 2, 4> DoubleType;
+    typedef ghmm::GHMMDefaultTraits< 
+      double, 2, 4, 
+      ghmm::LinearIndex, ghmm::NullTrace, ghmm::RenumberingNodes, ghmm::FlushDenormals 
+    > FlushTraits;
+    typedef ghmm::GHMM<double, 2, 4, FlushTraits> FlushType;
+
+    FloatType single( 
+      FloatType::full_matrix_type::Identity(), 
+      FloatType::observation_matrix_type::Identity(), 
+      4 * FloatType::goal_matrix_type::Identity(), 
+      1, 0.1, 0.001, 0.001 
+    );
+    DoubleType reference( 
+      DoubleType::full_matrix_type::Identity(), 
+      DoubleType::observation_matrix_type::Identity(), 
+      4 * DoubleType::goal_matrix_type::Identity(), 
+      1, 0.1, 0.001, 0.001 
+    );
+    FlushType flushed( 
+      FlushType::full_matrix_type::Identity(), 
+      FlushType::observation_matrix_type::Identity(), 
+      4 * FlushType::goal_matrix_type::Identity(), 
+      1, 0.1, 0.001, 0.001 
+    );
+
+    // Lanes far enough apart for most nodes to be at the floor
+    for ( int i = 0; i < 3; ++i ) {
+      FloatType::trajectory_type singleTrajectory;
+      DoubleType::trajectory_type trajectory;
+      for ( int j = 0; j < 40; ++j ) {
+        DoubleType::full_observation_type o;
+        o << j / 2.0, 10 * i, 10 * i, j / 40.0;
+        trajectory.push_back( o );
+        singleTrajectory.push_back( o.cast<float>() );
+      }
+      single.learn( singleTrajectory.begin(), singleTrajectory.end() );
+      reference.learn( trajectory.begin(), trajectory.end() );
+      flushed.learn( trajectory.begin(), trajectory.end() );
+    }
+    CHECK_EQUAL( num_vertices( reference.graph() ), num_vertices( single.graph() ) );
+    CHECK_EQUAL( num_vertices( reference.graph() ), num_vertices( flushed.graph() ) );
+
+    FloatType::track_type singleTrack;
+    DoubleType::track_type track;
+    FlushType::track_type flushedTrack;
+    single.initTrack( singleTrack );
+    reference.initTrack( track );
+    flushed.initTrack( flushedTrack );
+    for ( int j = 0; j < 20; ++j ) {
+      DoubleType::observation_type o;
+      o << j / 2.0, 10;
+      single.update( singleTrack, o.cast<float>() );
+      reference.update( track, o );
+      flushed.update( flushedTrack, o );
+    }
+    single.predict( singleTrack, 10 );
+    reference.predict( track, 10 );
+    flushed.predict( flushedTrack, 10 );
+
+    for ( int i = 0; i < 3; ++i ) {
+      DoubleType::goal_type g;
+      g << 10 * i, 1;
+      double expected = reference.goalPdf( track, g );
+      CHECK_CLOSE( expected, single.goalPdf( singleTrack, g.cast<float>() ), 1E-4 );
+      CHECK_CLOSE( expected, flushed.goalPdf( flushedTrack, g ), 1E-12 );
+    }
+
+    // The floating point environment is restored after each call
+    volatile float tiny = 1E-40f;
+    CHECK( tiny * 0.5f > 0 );
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( PoolHorizons )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    typedef ghmm::TrackerPool<double, 2, 4> PoolType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.01, 0.001, 0.001 );
+
+    for ( int i = 0; i < 3; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 10.0, i, i, j / 100.0;
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+
+    // Rows of longer horizons stay allocated, and are reused while tracks
+    // come and go
+    GHMMType::compiled_type compiled = ghmm.compile();
+    PoolType pool( compiled );
+    std::vector< GHMMType::track_type > tracks( 2 );
+    std::vector< PoolType::track_id > ids;
+    for ( int i = 0; i < 2; ++i ) {
+      ids.push_back( pool.add() );
+      compiled.initTrack( tracks[i] );
+    }
+
+    const uint8_t horizons[] = { 6, 2, 0, 4, 8, 1 };
+    for ( int j = 0; j < 12; ++j ) {
+      if ( j == 5 ) {
+        pool.remove( ids[0] );
+        ids[0] = pool.add();
+        compiled.initTrack( tracks[0] );
+      }
+      for ( int i = 0; i < 2; ++i ) {
+        GHMMType::observation_type o;
+        o << j / 3.0, i;
+        pool.observe( ids[i], o );
+        compiled.update( tracks[i], o );
+      }
+      pool.update();
+      CHECK_EQUAL( 0u, pool.horizon() );
+
+      uint8_t horizon = horizons[j % 6];
+      pool.predict( horizon );
+      CHECK_EQUAL( horizon, pool.horizon() );
+      for ( int i = 0; i < 2; ++i ) {
+        compiled.predict( tracks[i], horizon );
+        for ( uint32_t n = 0; n < compiled.nodeCount(); ++n ) {
+          CHECK_CLOSE( 
+            tracks[i].estimation( horizon, n ), 
+            pool.estimation( ids[i], horizon, n ), 
+            1E-10 
+          );
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( ModelHandle )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    typedef ghmm::ModelHandle<double, 2, 4> HandleType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.4, 0.001, 0.001 );
+
+    // Crossing and noisy enough for the ITM to remove nodes, see StableNodes
+    std::vector< GHMMType::trajectory_type > trajectories( 10 );
+    for ( int i = 0; i < 10; ++i ) {
+      for ( int j = 0; j < 60; ++j ) {
+        double a = i * 0.7;
+        double noise = 1.2 * std::sin( 12.9898 * ( i * 60 + j ) );
+        GHMMType::full_observation_type o;
+        o << j / 6.0 * std::cos( a ) + noise, 
+             j / 6.0 * std::sin( a ) - noise, 
+             std::cos( a ), 
+             std::sin( a );
+        trajectories[i].push_back( o );
+      }
+    }
+    ghmm.learnBatch( trajectories.begin(), trajectories.begin() + 3 );
+
+    HandleType handle( ghmm );
+    HandleType::snapshot_ptr pinned = handle.pin();
+    CHECK_EQUAL( ghmm.model().nodeCount(), pinned->model().nodeCount() );
+    GHMMType::track_type track;
+    pinned->model().initTrack( track );
+    for ( int j = 0; j < 20; ++j ) {
+      pinned->model().update( track, trajectories[0][j].head<2>() );
+    }
+    std::vector< uint64_t > serials = ghmm.serials();
+    GHMMType::track_type before = track;
+
+    ghmm.learnBatch( trajectories.begin() + 3, trajectories.end() );
+    handle.publish( ghmm );
+
+    // The pinned snapshot is left as it was
+    CHECK_EQUAL( serials.size(), pinned->model().nodeCount() );
+    CHECK_EQUAL( 0u, pinned->version() );
+    CHECK_EQUAL( 1u, handle.pin()->version() );
+
+    const std::vector< uint64_t > & latest = ghmm.serials();
+    uint32_t removed = 0;
+    for ( uint32_t i = 0; i < serials.size(); ++i ) {
+      if ( std::find( latest.begin(), latest.end(), serials[i] ) == latest.end() ) {
+        ++removed;
+      }
+    }
+    CHECK( removed > 0 );
+
+    // The belief follows the nodes that stayed
+    CHECK( handle.refresh( pinned, track ) );
+    CHECK_EQUAL( 1u, pinned->version() );
+    CHECK_EQUAL( latest.size(), track.nodeCount );
+    double floor = GHMMType::numerics_type::floor();
+    std::vector< double > expected( latest.size(), floor );
+    double total = 0;
+    for ( uint32_t n = 0; n < latest.size(); ++n ) {
+      std::vector< uint64_t >::iterator s = std::find( serials.begin(), serials.end(), latest[n] );
+      if ( s != serials.end() ) {
+        expected[n] = std::max( before.belief( s - serials.begin() ), floor );
+      }
+      total += expected[n];
+    }
+    for ( uint32_t n = 0; n < latest.size(); ++n ) {
+      CHECK_CLOSE( expected[n] / total, track.belief( n ), 1E-12 );
+    }
+
+    CHECK( ! handle.refresh( pinned, track ) );
+    pinned->model().update( track, trajectories[0][20].head<2>() );
+    pinned->model().predict( track, 3 );
+    CHECK_EQUAL( 3u, track.horizon() );
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( GoalPosterior )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    typedef GHMMType::compiled_type CompiledType;
+    GHMMType::goal_matrix_type goalSigma;
+    goalSigma << 4.0, 1.0,
+                 1.0, 3.0;
+    GHMMType::full_matrix_type fullSigma;
+    fullSigma << 1.0, 0.0, 0.0, 0.0,
+                 0.0, 1.0, 0.0, 0.0,
+                 0.0, 0.0, 4.0, 1.0,
+                 0.0, 0.0, 1.0, 3.0;
+    GHMMType ghmm( 
+      fullSigma, 
+      GHMMType::observation_matrix_type::Identity(),
+      goalSigma,
+      1, 0.01,
+      0.001, 0.001
+    );
+
+    // Three lanes going to different goals
+    for ( int i = 0; i < 3; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, 3 * i, 10.0, 3 * i;
+        trajectory.push_back( o );
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+    }
+
+    GHMMType::track_type track;
+    ghmm.initTrack( track );
+    for ( int j = 0; j < 10; ++j ) {
+      GHMMType::observation_type o;
+      o << j / 5.0, 3;
+      ghmm.update( track, o );
+    }
+
+    // A 9 x 9 grid over the goal space
+    CompiledType::goal_batch_type goals( 81, 2 );
+    for ( int x = 0; x < 9; ++x ) {
+      for ( int y = 0; y < 9; ++y ) {
+        goals.row( x * 9 + y ) << 6 + x, y - 1;
+      }
+    }
+    CompiledType::density_matrix_type posteriors;
+    ghmm.goalPosterior( track, goals, posteriors );
+    CHECK_EQUAL( 81, posteriors.rows() );
+    CHECK_CLOSE( 1.0, posteriors.sum(), 1E-12 );
+
+    double total = 0;
+    for ( int q = 0; q < 81; ++q ) {
+      GHMMType::goal_type goal = goals.row( q );
+      total += ghmm.goalPdf( track, goal );
+    }
+    for ( int q = 0; q < 81; ++q ) {
+      GHMMType::goal_type goal = goals.row( q );
+      CHECK_CLOSE( 1.0, posteriors( q, 0 ) * total / ghmm.goalPdf( track, goal ), 1E-12 );
+    }
+
+    // The goal of the middle lane ranks first
+    CompiledType::index_array best;
+    CompiledType::value_array bestPosteriors;
+    ghmm.topGoals( track, goals, 5, best, bestPosteriors );
+    CHECK_EQUAL( 5u, best.size() );
+    CHECK_EQUAL( 4 * 9 + 4, int( best[0] ) );
+    for ( uint32_t i = 0; i < best.size(); ++i ) {
+      CHECK_EQUAL( posteriors( best[i], 0 ), bestPosteriors[i] );
+      if ( i > 0 ) {
+        CHECK( bestPosteriors[i] <= bestPosteriors[i - 1] );
+      }
+    }
+    for ( int q = 0; q < 81; ++q ) {
+      if ( std::find( best.begin(), best.end(), uint32_t( q ) ) == best.end() ) {
+        CHECK( posteriors( q, 0 ) <= bestPosteriors.back() );
+      }
+    }
+
+    ghmm.topGoals( track, goals.topRows( 3 ), 5, best, bestPosteriors );
+    CHECK_EQUAL( 3u, best.size() );
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( GaussianKernel )
+  {
+    typedef Eigen::Matrix<double, 1, 3> VectorType;
+    typedef Eigen::Matrix<double, 3, 3> MatrixType;
+    typedef ghmm::GaussianKernel<double, MatrixType, VectorType> KernelType;
+    MatrixType sigma;
+    sigma << 2.0, 0.5, 0.0,
+             0.5, 1.0, 0.3,
+             0.0, 0.3, 3.0;
+    ghmm::Gaussian<double, MatrixType, VectorType> gaussian( sigma );
+    KernelType kernel( sigma );
+
+    // An odd count, so that some centroids are left after the last packet
+    std::vector< VectorType, Eigen::aligned_allocator<VectorType> > centroids( 37 );
+    kernel.resize( centroids.size() );
+    for ( uint32_t n = 0; n < centroids.size(); ++n ) {
+      centroids[n] << std::sin( n * 1.3 ), 2 * std::cos( n * 0.7 ), n / 10.0;
+      kernel.set( n, centroids[n] );
+    }
+
+    VectorType o;
+    o << 0.3, -0.2, 1.5;
+    std::vector< double > logs( centroids.size() );
+    std::vector< double > likelihoods( centroids.size() );
+    kernel.logLikelihoods( o, 0, centroids.size(), &logs[0] );
+    // Only part of the centroids, into the middle of the buffer
+    kernel.likelihoods( o, 5, 30, 1E-10, &likelihoods[5] );
+    for ( uint32_t n = 0; n < centroids.size(); ++n ) {
+      double expected = gaussian( o, centroids[n] );
+      CHECK_CLOSE( std::log( expected ), logs[n], 1E-10 );
+      CHECK_CLOSE( 
+        -2 * logs[n], kernel.distance( kernel.whiten( o ), n ), 1E-10 
+      );
+      if ( n >= 5 && n < 35 ) {
+        CHECK_CLOSE( expected + 1E-10, likelihoods[n], 1E-12 );
+      }
+    }
+
+    // Centroids given as one array per dimension
+    std::vector< double > arrays( 3 * centroids.size() );
+    for ( uint32_t n = 0; n < centroids.size(); ++n ) {
+      for ( int d = 0; d < 3; ++d ) {
+        arrays[d * centroids.size() + n] = centroids[n][d];
+      }
+    }
+    KernelType assigned( sigma );
+    assigned.assign( &arrays[0], centroids.size(), centroids.size() );
+    CHECK_EQUAL( kernel.size(), assigned.size() );
+    for ( int d = 0; d < 3; ++d ) {
+      CHECK_ARRAY_CLOSE( kernel.centroids( d ), assigned.centroids( d ), int( centroids.size() ), 0 );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( ObservationLikelihoods )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    typedef GHMMType::compiled_type CompiledType;
+    GHMMType::observation_matrix_type observationSigma;
+    observationSigma << 1.0, 0.4,
+                        0.4, 2.0;
+    GHMMType ghmm( 
+      GHMMType::full_matrix_type::Identity(), 
+      observationSigma,
+      GHMMType::goal_matrix_type::Identity(),
+      1, 0.01,
+      0.001, 0.001
+    );
+    GHMMType::trajectory_type trajectory;
+    for ( int j = 0; j < 50; ++j ) {
+      GHMMType::full_observation_type o;
+      o << j / 5.0, std::sin( j / 5.0 ), 10.0, 1.0;
+      trajectory.push_back( o );
+    }
+    ghmm.learn( trajectory.begin(), trajectory.end() );
+
+    const CompiledType & model = ghmm.model();
+    const GHMMType::graph_type & graph = ghmm.graph();
+    ghmm::Gaussian< 
+      double, GHMMType::observation_matrix_type, GHMMType::observation_type 
+    > gaussian( observationSigma );
+
+    GHMMType::observation_type o;
+    o << 4.2, 0.5;
+    std::vector< double > likelihoods( model.nodeCount() );
+    std::vector< double > logs( model.nodeCount() );
+    model.observationLikelihoods( o, &likelihoods[0] );
+    model.observationLogLikelihoods( o, &logs[0] );
+    for ( uint32_t n = 0; n < model.nodeCount(); ++n ) {
+      double expected = gaussian( 
+        o, GHMMType::traits_type::toObservation( graph[boost::vertex( n, graph )].centroid ) 
+      );
+      CHECK_CLOSE( expected + CompiledType::numerics_type::floor(), likelihoods[n], 1E-12 );
+      CHECK_CLOSE( std::log( expected ), logs[n], 1E-9 );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( AnyGHMM )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    typedef ghmm::AnyGHMM<double> AnyType;
+    GHMMType::full_matrix_type fullSigma;
+    fullSigma << 1.0, 0.2, 0.0, 0.0,
+                 0.2, 1.0, 0.0, 0.0,
+                 0.0, 0.0, 4.0, 1.0,
+                 0.0, 0.0, 1.0, 3.0;
+    GHMMType::observation_matrix_type observationSigma;
+    observationSigma << 1.0, 0.2,
+                        0.2, 1.0;
+    GHMMType::goal_matrix_type goalSigma;
+    goalSigma << 4.0, 1.0,
+                 1.0, 3.0;
+    GHMMType ghmm( fullSigma, observationSigma, goalSigma, 1, 0.01, 0.001, 0.001 );
+
+    AnyType::settings_type settings;
+    settings.fullSigma = fullSigma;
+    settings.observationSigma = observationSigma;
+    settings.goalSigma = goalSigma;
+    settings.insertionDistance = 1;
+    settings.epsilon = 0.01;
+    settings.statePrior = 0.001;
+    settings.transitionPrior = 0.001;
+
+    CHECK( AnyType::specialized( 2, 4 ) );
+    CHECK( ! AnyType::specialized( 2, 5 ) );
+    AnyType exact = AnyType::create( 2, 4, settings );
+    // The same model embedded in the widest specialization
+    AnyType embedded( new ghmm::SpecializedGHMM<double, 8, 16>( 2, 4, settings ) );
+    CHECK_EQUAL( 2, embedded.observationDimension() );
+    CHECK_EQUAL( 4, embedded.fullDimension() );
+
+    for ( int i = 0; i < 3; ++i ) {
+      GHMMType::trajectory_type trajectory;
+      AnyType::trajectory_type rows( 50, 4 );
+      for ( int j = 0; j < 50; ++j ) {
+        GHMMType::full_observation_type o;
+        o << j / 5.0, 3 * i + std::sin( j / 3.0 ), 10.0, 3 * i;
+        trajectory.push_back( o );
+        rows.row( j ) = o;
+      }
+      ghmm.learn( trajectory.begin(), trajectory.end() );
+      exact.learn( rows );
+      embedded.learn( rows );
+    }
+    CHECK_EQUAL( ghmm.model().nodeCount(), exact.nodeCount() );
+    CHECK_EQUAL( ghmm.model().edgeCount(), exact.edgeCount() );
+    CHECK_EQUAL( ghmm.model().nodeCount(), embedded.nodeCount() );
+    CHECK_EQUAL( ghmm.model().edgeCount(), embedded.edgeCount() );
+
+    GHMMType::track_type track;
+    AnyType::track_type exactTrack;
+    AnyType::track_type embeddedTrack;
+    ghmm.initTrack( track );
+    exact.initTrack( exactTrack );
+    embedded.initTrack( embeddedTrack );
+    for ( int j = 0; j < 20; ++j ) {
+      GHMMType::observation_type o;
+      o << j / 4.0, 3 + std::sin( j / 2.0 );
+      AnyType::vector_type v = o;
+      ghmm.update( track, o );
+      exact.update( exactTrack, v );
+      embedded.update( embeddedTrack, v );
+    }
+    ghmm.predict( track, 5 );
+    exact.predict( exactTrack, 5 );
+    embedded.predict( embeddedTrack, 5 );
+    CHECK_ARRAY_CLOSE( track.estimations, exactTrack.estimations, int( 6 * track.nodeCount ), 1E-12 );
+    CHECK_ARRAY_CLOSE( track.estimations, embeddedTrack.estimations, int( 6 * track.nodeCount ), 1E-12 );
+
+    GHMMType::observation_type o;
+    o << 6.0, 3.5;
+    GHMMType::goal_type g;
+    g << 10.0, 3.0;
+    AnyType::vector_type v = o;
+    AnyType::vector_type w = g;
+    double expected = ghmm.observationPdf( track, 5, o );
+    CHECK_CLOSE( expected, exact.observationPdf( exactTrack, 5, v ), 1E-12 * expected );
+    CHECK_CLOSE( expected, embedded.observationPdf( embeddedTrack, 5, v ), 1E-12 * expected );
+    expected = ghmm.goalPdf( track, g );
+    CHECK_CLOSE( expected, exact.goalPdf( exactTrack, w ), 1E-12 * expected );
+    CHECK_CLOSE( expected, embedded.goalPdf( embeddedTrack, w ), 1E-12 * expected );
+
+    // Dimensions without a specialization, saved and restored
+    AnyType::settings_type wide = settings;
+    wide.fullSigma = AnyType::matrix_type::Identity( 7, 7 );
+    wide.observationSigma = AnyType::matrix_type::Identity( 5, 5 );
+    wide.goalSigma = AnyType::matrix_type::Identity( 2, 2 );
+    AnyType other = AnyType::create( 5, 7, wide );
+    AnyType::trajectory_type rows( 30, 7 );
+    for ( int j = 0; j < 30; ++j ) {
+      rows.row( j ) << j / 5.0, 1, 2, 3, 4, 10.0, 0;
+    }
+    other.learn( rows );
+    const char * path = "TestAnyGHMM.model";
+    other.save( path );
+    AnyType restored = AnyType::load( path, 5, 7 );
+    std::remove( path );
+    CHECK_EQUAL( other.nodeCount(), restored.nodeCount() );
+    AnyType::track_type otherTrack;
+    AnyType::track_type restoredTrack;
+    other.initTrack( otherTrack );
+    restored.initTrack( restoredTrack );
+    AnyType::vector_type p = rows.row( 10 ).head( 5 );
+    other.update( otherTrack, p );
+    restored.update( restoredTrack, p );
+    CHECK_ARRAY_CLOSE( otherTrack.estimations, restoredTrack.estimations, int( other.nodeCount() ), 0 );
+
+    CHECK_THROW( AnyType::create( 9, 12, wide ), std::invalid_argument );
+    CHECK_THROW( AnyType::create( 5, 8, wide ), std::invalid_argument );
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( Reorder )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.4, 0.001, 0.001 );
+
+    // Crossing and noisy enough for the ITM to remove and reuse nodes
+    std::vector< GHMMType::trajectory_type > trajectories( 10 );
+    for ( int i = 0; i < 10; ++i ) {
+      for ( int j = 0; j < 60; ++j ) {
+        double a = i * 0.7;
+        double noise = 1.2 * std::sin( 12.9898 * ( i * 60 + j ) );
+        GHMMType::full_observation_type o;
+        o << j / 6.0 * std::cos( a ) + noise, 
+             j / 6.0 * std::sin( a ) - noise, 
+             std::cos( a ), 
+             std::sin( a );
+        trajectories[i].push_back( o );
+      }
+    }
+    ghmm.learnBatch( trajectories.begin(), trajectories.end() );
+
+    GHMMType::compiled_type before = ghmm.model();
+    std::vector< uint64_t > serials = ghmm.serials();
+    uint32_t bandwidth = 0;
+    GHMMType::graph_type::edge_iterator e;
+    GHMMType::graph_type::edge_iterator edgeEnd;
+    for ( tie( e, edgeEnd ) = edges( ghmm.graph() ); e != edgeEnd; ++e ) {
+      bandwidth = std::max< uint32_t >( 
+        bandwidth, 
+        std::abs( int( source( *e, ghmm.graph() ) ) - int( target( *e, ghmm.graph() ) ) ) 
+      );
+    }
+
+    ghmm.reorder();
+    const GHMMType::compiled_type & after = ghmm.model();
+    CHECK_EQUAL( before.nodeCount(), after.nodeCount() );
+    CHECK_EQUAL( before.edgeCount(), after.edgeCount() );
+    uint32_t reordered = 0;
+    for ( tie( e, edgeEnd ) = edges( ghmm.graph() ); e != edgeEnd; ++e ) {
+      reordered = std::max< uint32_t >( 
+        reordered, 
+        std::abs( int( source( *e, ghmm.graph() ) ) - int( target( *e, ghmm.graph() ) ) ) 
+      );
+    }
+    CHECK( reordered < bandwidth );
+
+    // Every node keeps its serial, and so its belief
+    std::vector< uint32_t > position( after.nodeCount() );
+    for ( uint32_t n = 0; n < after.nodeCount(); ++n ) {
+      std::vector< uint64_t >::iterator s = std::find( 
+        serials.begin(), serials.end(), ghmm.serials()[n] 
+      );
+      CHECK( s != serials.end() );
+      position[n] = s - serials.begin();
+    }
+    GHMMType::track_type trackBefore;
+    GHMMType::track_type trackAfter;
+    before.initTrack( trackBefore );
+    after.initTrack( trackAfter );
+    for ( int j = 0; j < 30; ++j ) {
+      GHMMType::observation_type o = trajectories[4][j].head<2>();
+      before.update( trackBefore, o );
+      after.update( trackAfter, o );
+      CHECK_CLOSE( 
+        before.observationPdf( trackBefore, 0, o ), 
+        after.observationPdf( trackAfter, 0, o ), 
+        1E-12 
+      );
+    }
+    before.predict( trackBefore, 5 );
+    after.predict( trackAfter, 5 );
+    for ( uint32_t n = 0; n < after.nodeCount(); ++n ) {
+      CHECK_CLOSE( trackBefore.belief( position[n] ), trackAfter.belief( n ), 1E-12 );
+    }
+    GHMMType::goal_type g = trajectories[4][0].tail<2>();
+    CHECK_CLOSE( 
+      before.goalPdf( trackBefore, g ), 
+      after.goalPdf( trackAfter, g ), 
+      1E-12 
+    );
+
+    // Any order
+    serials = ghmm.serials();
+    std::vector< GHMMType::node_type > order( serials.size() );
+    for ( uint32_t n = 0; n < order.size(); ++n ) {
+      order[n] = order.size() - 1 - n;
+    }
+    ghmm.reorder( order );
+    std::reverse( serials.begin(), serials.end() );
+    CHECK( serials == ghmm.serials() );
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( IncrementalNormalize )
+  {
+    typedef ghmm::GHMM<double, 2, 4> GHMMType;
+    Sigmas< GHMMType > sigma;
+    GHMMType ghmm( sigma.full, sigma.observation, sigma.goal, 1, 0.4, 0.001, 0.001 );
+
+    // Crossing and noisy enough for the ITM to remove nodes
+    std::vector< GHMMType::trajectory_type > trajectories( 10 );
+    for ( int i = 0; i < 10; ++i ) {
+      for ( int j = 0; j < 60; ++j ) {
+        double a = i * 0.7;
+        double noise = 1.2 * std::sin( 12.9898 * ( i * 60 + j ) );
+        GHMMType::full_observation_type o;
+        o << j / 6.0 * std::cos( a ) + noise, 
+             j / 6.0 * std::sin( a ) - noise, 
+             std::cos( a ), 
+             std::sin( a );
+        trajectories[i].push_back( o );
+      }
+    }
+    ghmm.learnBatch( trajectories.begin(), trajectories.begin() + 3 );
+
+    // Without smoothing, priors come from the prior sum normalize keeps
+    // while the ITM adds and removes nodes. They must match the full sum.
+    std::vector< uint64_t > serials = ghmm.serials();
+    GHMMType::session_id session = ghmm.beginTrajectory( 1000 );
+    const GHMMType::graph_type & g = ghmm.graph();
+    for ( int i = 3; i < 10; ++i ) {
+      for ( int j = 0; j < 60; j += 3 ) {
+        ghmm.observe( session, trajectories[i][j] );
+
+        double total = 0;
+        GHMMType::node_iterator n;
+        GHMMType::node_iterator nodeEnd;
+        for ( tie( n, nodeEnd ) = vertices( g ); n != nodeEnd; ++n ) {
+          total += g[*n].probabilitySum;
+        }
+        for ( tie( n, nodeEnd ) = vertices( g ); n != nodeEnd; ++n ) {
+          CHECK_CLOSE( g[*n].probabilitySum / total, g[*n].probability, 1E-12 );
+          CHECK( edge( *n, *n, g ).second );
+          double transitions = 0;
+          GHMMType::out_edge_iterator e;
+          GHMMType::out_edge_iterator eEnd;
+          for ( tie( e, eEnd ) = out_edges( *n, g ); e != eEnd; ++e ) {
+            transitions += g[*e].probability;
+          }
+          CHECK_CLOSE( 1.0, transitions, 1E-12 );
+        }
+      }
+    }
+    ghmm.endTrajectory( session );
+
+    const std::vector< uint64_t > & latest = ghmm.serials();
+    uint32_t removed = 0;
+    for ( uint32_t i = 0; i < serials.size(); ++i ) {
+      if ( std::find( latest.begin(), latest.end(), serials[i] ) == latest.end() ) {
+        ++removed;
+      }
+    }
+    CHECK( removed > 0 );
+  }
+}
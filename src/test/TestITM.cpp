@@ -4,7 +4,11 @@
 #include <eigen3/Eigen/Core>
 #include <eigen3/Eigen/Dense>
 #include <boost/graph/adjacency_list.hpp>
+#include <ghmm/GridIndex.hpp>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 
 struct NodeData {
@@ -16,6 +20,39 @@ struct EdgeData {
 
 typedef boost::adjacency_list< boost::hash_setS, boost::vecS, boost::bidirectionalS, NodeData, EdgeData > Graph;
 
+// Centroids in lexicographic order, and edges between their positions in it,
+// to compare graphs that number their nodes differently
+typedef std::vector< std::vector<float> > centroid_list;
+typedef std::vector< std::pair<uint32_t, uint32_t> > edge_list;
+
+void sortedGraph( const Graph & g, centroid_list & centroids, edge_list & edges )
+{
+  centroids.clear();
+  Graph::vertex_iterator n;
+  Graph::vertex_iterator nEnd;
+  for ( boost::tie( n, nEnd ) = boost::vertices( g ); n != nEnd; ++n ) {
+    centroids.push_back( 
+      std::vector<float>( g[*n].centroid.data(), g[*n].centroid.data() + 4 ) 
+    );
+  }
+  centroid_list sorted = centroids;
+  std::sort( sorted.begin(), sorted.end() );
+  std::vector<uint32_t> rank( centroids.size() );
+  for ( uint32_t i = 0; i < centroids.size(); ++i ) {
+    rank[i] = std::lower_bound( sorted.begin(), sorted.end(), centroids[i] ) - sorted.begin();
+  }
+  edges.clear();
+  Graph::edge_iterator e;
+  Graph::edge_iterator eEnd;
+  for ( boost::tie( e, eEnd ) = boost::edges( g ); e != eEnd; ++e ) {
+    edges.push_back( 
+      std::make_pair( rank[boost::source( *e, g )], rank[boost::target( *e, g )] ) 
+    );
+  }
+  std::sort( edges.begin(), edges.end() );
+  centroids.swap( sorted );
+}
+
 SUITE( ITM ) {
 
   //----------------------------------------------------------------------------
@@ -45,5 +82,306 @@ SUITE( ITM ) {
     }
   }
 
-}
+  //----------------------------------------------------------------------------
+
+  TEST( GridIndexMatchesLinearScan )
+  {
+    typedef ghmm::itm_eigen_traits< Graph, float, 4 > LinearTraits;
+    typedef ghmm::itm_eigen_traits< Graph, float, 4, ghmm::GridIndex > GridTraits;
+
+    LinearTraits::matrix_type sigma;
+    sigma << 1.0, 0.0, 0.0, 0.0, 
+             0.0, 1.0, 0.0, 0.0,
+             0.0, 0.0, 4.0, 0.0,
+             0.0, 0.0, 0.0, 4.0;
+
+    Graph linear;
+    Graph grid;
+    ghmm::ITM< LinearTraits > linearItm( 
+      linear, 
+      LinearTraits::distance_type( sigma ), 
+      1, 0.4 
+    );
+    ghmm::ITM< GridTraits > gridItm( 
+      grid, 
+      GridTraits::distance_type( sigma ), 
+      1, 0.4 
+    );
+
+    // Crossing, noisy trajectories so that centroids drift across cells and
+    // nodes get deleted.
+    for ( int i = 0; i < 20; ++i ) {
+      for ( int j = 0; j < 60; ++j ) {
+        float a = i * 0.7f;
+        float noise = 1.2f * std::sin( 12.9898f * ( i * 60 + j ) );
+        LinearTraits::observation_type o;
+        o << j / 6.0 * std::cos( a ) + noise, 
+             j / 6.0 * std::sin( a ) - noise, 
+             std::cos( a ), 
+             std::sin( a );
+        linearItm( o );
+        gridItm( o );
+
+        CHECK_EQUAL( boost::num_vertices( linear ), boost::num_vertices( grid ) );
+        CHECK_EQUAL( boost::num_edges( linear ), boost::num_edges( grid ) );
+      }
+    }
+
+    Graph::vertex_iterator n;
+    Graph::vertex_iterator nEnd;
+    for ( boost::tie( n, nEnd ) = boost::vertices( linear ); n != nEnd; ++n ) {
+      CHECK( linear[*n].centroid == grid[*n].centroid );
+
+      std::vector<Graph::vertex_descriptor> linearChildren;
+      std::vector<Graph::vertex_descriptor> gridChildren;
+      Graph::adjacency_iterator c;
+      Graph::adjacency_iterator cEnd;
+      for ( boost::tie( c, cEnd ) = boost::adjacent_vertices( *n, linear ); c != cEnd; ++c ) {
+        linearChildren.push_back( *c );
+      }
+      for ( boost::tie( c, cEnd ) = boost::adjacent_vertices( *n, grid ); c != cEnd; ++c ) {
+        gridChildren.push_back( *c );
+      }
+      std::sort( linearChildren.begin(), linearChildren.end() );
+      std::sort( gridChildren.begin(), gridChildren.end() );
+      CHECK( linearChildren == gridChildren );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( StableNodes )
+  {
+    typedef ghmm::itm_eigen_traits< Graph, float, 4 > RenumberingTraits;
+    typedef ghmm::itm_eigen_traits< 
+      Graph, float, 4, ghmm::LinearIndex, ghmm::NullTrace, ghmm::StableNodes 
+    > StableTraits;
+
+    RenumberingTraits::matrix_type sigma;
+    sigma << 1.0, 0.0, 0.0, 0.0, 
+             0.0, 1.0, 0.0, 0.0,
+             0.0, 0.0, 4.0, 0.0,
+             0.0, 0.0, 0.0, 4.0;
+
+    Graph renumbering;
+    Graph stable;
+    ghmm::ITM< RenumberingTraits > renumberingItm( 
+      renumbering, 
+      RenumberingTraits::distance_type( sigma ), 
+      1, 0.4 
+    );
+    ghmm::ITM< StableTraits > stableItm( 
+      stable, 
+      StableTraits::distance_type( sigma ), 
+      1, 0.4 
+    );
+
+    // Same trajectories as GridIndexMatchesLinearScan, the stable graph is
+    // compacted after each one
+    bool tombstones = false;
+    uint32_t previous = 0;
+    for ( int i = 0; i < 20; ++i ) {
+      for ( int j = 0; j < 60; ++j ) {
+        float a = i * 0.7f;
+        float noise = 1.2f * std::sin( 12.9898f * ( i * 60 + j ) );
+        RenumberingTraits::observation_type o;
+        o << j / 6.0 * std::cos( a ) + noise, 
+             j / 6.0 * std::sin( a ) - noise, 
+             std::cos( a ), 
+             std::sin( a );
+        renumberingItm( o );
+        stableItm( o );
+        CHECK( boost::num_vertices( stable ) >= boost::num_vertices( renumbering ) );
+        tombstones = tombstones || boost::num_vertices( stable ) > boost::num_vertices( renumbering );
+      }
+
+      Graph before = stable;
+      const std::vector<Graph::vertex_descriptor> & moved = stableItm.compact();
 
+      // Nodes of the previous compaction keep their order and their data
+      CHECK_EQUAL( previous, moved.size() );
+      Graph::vertex_descriptor next = 0;
+      for ( uint32_t n = 0; n < moved.size(); ++n ) {
+        if ( moved[n] != Graph::null_vertex() ) {
+          CHECK( moved[n] >= next );
+          next = moved[n] + 1;
+          CHECK( before[n].centroid == stable[moved[n]].centroid );
+        }
+      }
+      previous = boost::num_vertices( stable );
+
+      centroid_list renumberingCentroids;
+      centroid_list stableCentroids;
+      edge_list renumberingEdges;
+      edge_list stableEdges;
+      sortedGraph( renumbering, renumberingCentroids, renumberingEdges );
+      sortedGraph( stable, stableCentroids, stableEdges );
+      CHECK( renumberingCentroids == stableCentroids );
+      CHECK( renumberingEdges == stableEdges );
+    }
+    CHECK( tombstones );
+  }
+
+
+  //----------------------------------------------------------------------------
+
+  TEST( WhitenedMetric )
+  {
+    typedef ghmm::itm_eigen_traits< Graph, float, 4 > MahalanobisTraits;
+    typedef ghmm::itm_eigen_traits< 
+      Graph, float, 4, ghmm::LinearIndex, ghmm::NullTrace, 
+      ghmm::RenumberingNodes, ghmm::WhitenedMetric 
+    > WhitenedTraits;
+    typedef ghmm::itm_eigen_traits< 
+      Graph, float, 4, ghmm::GridIndex, ghmm::NullTrace, 
+      ghmm::RenumberingNodes, ghmm::WhitenedMetric 
+    > GridTraits;
+
+    // Correlated, so that whitening is more than a scaling
+    MahalanobisTraits::matrix_type sigma;
+    sigma << 1.0, 0.3, 0.0, 0.0, 
+             0.3, 1.0, 0.0, 0.0,
+             0.0, 0.0, 4.0, 1.0,
+             0.0, 0.0, 1.0, 4.0;
+
+    Graph mahalanobis;
+    Graph whitened;
+    Graph grid;
+    ghmm::ITM< MahalanobisTraits > mahalanobisItm( 
+      mahalanobis, 
+      MahalanobisTraits::distance_type( sigma ), 
+      1, 0.4 
+    );
+    ghmm::ITM< WhitenedTraits > whitenedItm( 
+      whitened, 
+      WhitenedTraits::distance_type( sigma ), 
+      1, 0.4 
+    );
+    ghmm::ITM< GridTraits > gridItm( 
+      grid, 
+      GridTraits::distance_type( sigma ), 
+      1, 0.4 
+    );
+
+    for ( int i = 0; i < 20; ++i ) {
+      for ( int j = 0; j < 60; ++j ) {
+        float a = i * 0.7f;
+        float noise = 1.2f * std::sin( 12.9898f * ( i * 60 + j ) );
+        MahalanobisTraits::observation_type o;
+        o << j / 6.0 * std::cos( a ) + noise, 
+             j / 6.0 * std::sin( a ) - noise, 
+             std::cos( a ), 
+             std::sin( a );
+        mahalanobisItm( o );
+        whitenedItm( o );
+        gridItm( o );
+      }
+    }
+
+    // Centroids are kept as they are, only the comparisons change, so the
+    // same decisions give the same map
+    centroid_list mahalanobisCentroids;
+    centroid_list whitenedCentroids;
+    centroid_list gridCentroids;
+    edge_list mahalanobisEdges;
+    edge_list whitenedEdges;
+    edge_list gridEdges;
+    sortedGraph( mahalanobis, mahalanobisCentroids, mahalanobisEdges );
+    sortedGraph( whitened, whitenedCentroids, whitenedEdges );
+    sortedGraph( grid, gridCentroids, gridEdges );
+    CHECK( boost::num_vertices( whitened ) > 20 );
+    CHECK( mahalanobisCentroids == whitenedCentroids );
+    CHECK( mahalanobisEdges == whitenedEdges );
+    CHECK( whitenedCentroids == gridCentroids );
+    CHECK( whitenedEdges == gridEdges );
+  }
+
+  //----------------------------------------------------------------------------
+
+  TEST( Dirty )
+  {
+    typedef ghmm::itm_eigen_traits< 
+      Graph, float, 4, ghmm::LinearIndex, ghmm::NullTrace, ghmm::StableNodes 
+    > Traits;
+    typedef Graph::vertex_descriptor Node;
+    typedef std::vector< std::vector<Node> > target_list;
+
+    Traits::matrix_type sigma;
+    sigma << 1.0, 0.0, 0.0, 0.0, 
+             0.0, 1.0, 0.0, 0.0,
+             0.0, 0.0, 4.0, 0.0,
+             0.0, 0.0, 0.0, 4.0;
+
+    Graph g;
+    ghmm::ITM< Traits > itm( g, Traits::distance_type( sigma ), 1, 0.4 );
+
+    // Nodes that stay must be dirty when they moved or their out-edges
+    // changed, nodes that are new always
+    uint32_t changed = 0;
+    for ( int i = 0; i < 20; ++i ) {
+      Graph before = g;
+      target_list targets( boost::num_vertices( g ) );
+      for ( Node n = 0; n < targets.size(); ++n ) {
+        Graph::out_edge_iterator e;
+        Graph::out_edge_iterator eEnd;
+        for ( boost::tie( e, eEnd ) = boost::out_edges( n, g ); e != eEnd; ++e ) {
+          targets[n].push_back( boost::target( *e, g ) );
+        }
+        std::sort( targets[n].begin(), targets[n].end() );
+      }
+
+      for ( int j = 0; j < 60; ++j ) {
+        float a = i * 0.7f;
+        float noise = 1.2f * std::sin( 12.9898f * ( i * 60 + j ) );
+        Traits::observation_type o;
+        o << j / 6.0 * std::cos( a ) + noise, 
+             j / 6.0 * std::sin( a ) - noise, 
+             std::cos( a ), 
+             std::sin( a );
+        itm( o );
+      }
+      const std::vector<Node> & moved = itm.compact();
+      const std::vector<Node> & dirty = itm.dirty();
+      for ( uint32_t k = 1; k < dirty.size(); ++k ) {
+        CHECK( dirty[k - 1] < dirty[k] );
+      }
+
+      std::vector<bool> expected( boost::num_vertices( g ), true );
+      for ( Node n = 0; n < moved.size(); ++n ) {
+        Node m = moved[n];
+        if ( m == boost::graph_traits<Graph>::null_vertex() ) {
+          continue;
+        }
+        std::vector<Node> current;
+        Graph::out_edge_iterator e;
+        Graph::out_edge_iterator eEnd;
+        for ( boost::tie( e, eEnd ) = boost::out_edges( m, g ); e != eEnd; ++e ) {
+          current.push_back( boost::target( *e, g ) );
+        }
+        std::sort( current.begin(), current.end() );
+        std::vector<Node> previous;
+        for ( uint32_t t = 0; t < targets[n].size(); ++t ) {
+          if ( moved[targets[n][t]] != boost::graph_traits<Graph>::null_vertex() ) {
+            previous.push_back( moved[targets[n][t]] );
+          }
+        }
+        std::sort( previous.begin(), previous.end() );
+        expected[m] = 
+             previous.size() != targets[n].size() 
+          || previous != current 
+          || before[n].centroid != g[m].centroid;
+      }
+      for ( Node n = 0; n < expected.size(); ++n ) {
+        bool found = std::binary_search( dirty.begin(), dirty.end(), n );
+        if ( expected[n] ) {
+          CHECK( found );
+        }
+        changed += found;
+      }
+      CHECK( dirty.empty() || dirty.back() < boost::num_vertices( g ) );
+      itm.clean();
+      CHECK( itm.dirty().empty() );
+    }
+    CHECK( changed > 0 );
+  }
+}